@@ -5,11 +5,52 @@
 #include <conio.h>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <random>
+#include <climits>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <map>
+#include <filesystem>
+
+// memory mapped, locked files for the result cache
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// the request pipeline (--serve) needs C++20 coroutines, the rest of the program builds as C++17
+#if (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)) && defined(__has_include)
+#if __has_include(<coroutine>) && __has_include(<semaphore>)
+#include <coroutine>
+#include <semaphore>
+#define FAST_EXPLORER_ASYNC
+#endif
+#endif
 using namespace std;
 
 const int max_cities = 100;
 const float infinity = 1e6;
 const float cost_per_km = 20.0;
+const float average_speed = 60.0; // km/h, expected speed of a road unless set otherwise
 
 #define RESET "\033[0m"            // resets text and bg
 #define BOLD  "\033[1m"            // bold text
@@ -23,8 +64,193 @@ void slowPrint(std::string& message, int delayMilliseconds) {
 }
 
 
+///////////////////////////////////////// Tracing /////////////////////////////////////////
+
+// scoped spans around the expensive phases (loading, indexing, searching, path unpacking), written out as
+// chrome trace-event json that chrome://tracing or perfetto can open; spans are compiled in only when
+// FAST_EXPLORER_TRACE is defined, otherwise TRACE_SPAN expands to nothing and the hot loops are untouched
+
+struct TraceEvent {
+    const char* name; // string literal, never copied
+    long long start;  // microseconds since the tracer's epoch
+    long long duration;
+};
+
+// every thread appends to its own buffer, the lock is only contended while a trace is being written out
+class TraceBuffer {
+    public:
+        int thread;
+        mutex lock;
+        vector<TraceEvent> events;
+
+        TraceBuffer(int thread) {
+            this->thread = thread;
+        }
+};
+
+class Tracer {
+    private:
+        static mutex& registryLock() {
+            static mutex lock;
+            return lock;
+        }
+
+        static vector<unique_ptr<TraceBuffer>>& buffers() { // kept until exit so late writers never dangle
+            static vector<unique_ptr<TraceBuffer>> all;
+            return all;
+        }
+
+        static chrono::steady_clock::time_point epoch() {
+            static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            return start;
+        }
+
+        static void escape(ostream& out, const char* text) {
+            for (; *text != '\0'; text++) {
+                if (*text == '"' || *text == '\\') {
+                    out << '\\';
+                }
+                out << *text;
+            }
+        }
+
+    public:
+        static atomic<bool>& enabled() {
+            static atomic<bool> on(false);
+            return on;
+        }
+
+        static long long now() {
+            return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - epoch()).count();
+        }
+
+        static TraceBuffer& local() {
+            thread_local TraceBuffer* buffer = NULL;
+            if (buffer == NULL) {
+                lock_guard<mutex> guard(registryLock());
+                buffers().push_back(unique_ptr<TraceBuffer>(new TraceBuffer((int)buffers().size() + 1)));
+                buffer = buffers().back().get();
+            }
+            return *buffer;
+        }
+
+        static void record(const char* name, long long start, long long duration) {
+            TraceBuffer& buffer = local();
+            lock_guard<mutex> guard(buffer.lock);
+            buffer.events.push_back({ name, start, duration });
+        }
+
+        static void start() {
+            epoch();
+            enabled().store(true, memory_order_relaxed);
+        }
+
+        static int eventCount() {
+            lock_guard<mutex> guard(registryLock());
+            int count = 0;
+            for (int i = 0; i < buffers().size(); i++) {
+                lock_guard<mutex> bufferGuard(buffers()[i]->lock);
+                count += buffers()[i]->events.size();
+            }
+            return count;
+        }
+
+        // complete ("X") events, one tid per recording thread
+        static void writeChromeTrace(ostream& out) {
+            lock_guard<mutex> guard(registryLock());
+            out << "{\"traceEvents\":[";
+            bool first = true;
+            for (int i = 0; i < buffers().size(); i++) {
+                TraceBuffer& buffer = *buffers()[i];
+                lock_guard<mutex> bufferGuard(buffer.lock);
+                for (int j = 0; j < buffer.events.size(); j++) {
+                    const TraceEvent& event = buffer.events[j];
+                    out << (first ? "\n" : ",\n") << "{\"name\":\"";
+                    escape(out, event.name);
+                    out << "\",\"cat\":\"map\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.thread
+                        << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+                    first = false;
+                }
+            }
+            out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        }
+
+        static bool writeChromeTrace(const string& path) {
+            ofstream file(path.c_str());
+            if (!file) {
+                return false;
+            }
+            writeChromeTrace(file);
+            return (bool)file;
+        }
+};
+
+class TraceSpan {
+    private:
+        const char* name;
+        long long start;
+
+    public:
+        TraceSpan(const char* name) {
+            this->name = Tracer::enabled().load(memory_order_relaxed) ? name : NULL;
+            this->start = this->name != NULL ? Tracer::now() : 0;
+        }
+
+        ~TraceSpan() {
+            if (name != NULL) {
+                Tracer::record(name, start, Tracer::now() - start);
+            }
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+// records from construction until destruction and writes the trace to path, does nothing for an empty path
+class TraceSession {
+    private:
+        string path;
+
+    public:
+        TraceSession(const string& path) {
+            this->path = path;
+            if (path.empty()) {
+                return;
+            }
+#ifdef FAST_EXPLORER_TRACE
+            Tracer::start();
+#else
+            cerr << "tracing is not compiled in, rebuild with -DFAST_EXPLORER_TRACE to record " << path << endl;
+#endif
+        }
+
+        ~TraceSession() {
+            if (path.empty() || !Tracer::enabled().load()) {
+                return;
+            }
+            Tracer::enabled().store(false);
+            if (!Tracer::writeChromeTrace(path)) {
+                cerr << "could not write trace to " << path << endl;
+            }
+        }
+
+        TraceSession(const TraceSession&) = delete;
+        TraceSession& operator=(const TraceSession&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#ifdef FAST_EXPLORER_TRACE
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SPAN(name)
+#endif
+
+
 ///////////////////////////////////////// Haversine /////////////////////////////////////////
 
+const double pi = 3.14159265358979323846; // M_PI is not standard C++
+
 // degrees to radians
 float deg2rad(float deg) {
     return deg * (3.14159 / 180.0);
@@ -45,6 +271,70 @@ float haversine(float lat1, float lon1, float lat2, float lon2) {
     return r * c; // distance in km
 }
 
+// haversine in double precision with the exact pi and the mean earth radius
+double haversineDouble(double lat1, double lon1, double lat2, double lon2) {
+    const double r = 6371.0088; // mean radius of earth (km)
+    const double rad = pi / 180.0;
+
+    double sinLat = sin((lat2 - lat1) * rad / 2);
+    double sinLon = sin((lon2 - lon1) * rad / 2);
+    double a = sinLat * sinLat + cos(lat1 * rad) * cos(lat2 * rad) * sinLon * sinLon;
+
+    return 2 * r * asin(sqrt(a)); // distance in km
+}
+
+// flat earth approximation around the mean latitude, no trigonometry besides one cosine
+float equirectangular(float lat1, float lon1, float lat2, float lon2) {
+    const float r = 6371.0088f; // mean radius of earth (km)
+    const float rad = (float)(pi / 180.0);
+
+    float x = (lon2 - lon1) * rad * cosf((lat1 + lat2) * 0.5f * rad);
+    float y = (lat2 - lat1) * rad;
+
+    return r * sqrtf(x * x + y * y); // distance in km
+}
+
+// reference distance on the WGS-84 ellipsoid (vincenty's inverse formula), accurate to well under a metre,
+// too slow for searching but used to state the error of the faster kernels
+double vincenty(double lat1, double lon1, double lat2, double lon2) {
+    const double a = 6378.137;          // equatorial radius (km)
+    const double f = 1 / 298.257223563; // flattening
+    const double b = a * (1 - f);       // polar radius (km)
+    const double rad = pi / 180.0;
+
+    double L = (lon2 - lon1) * rad;
+    double U1 = atan((1 - f) * tan(lat1 * rad)); // reduced latitudes
+    double U2 = atan((1 - f) * tan(lat2 * rad));
+    double sinU1 = sin(U1), cosU1 = cos(U1);
+    double sinU2 = sin(U2), cosU2 = cos(U2);
+
+    double lambda = L, previous;
+    double sinSigma, cosSigma, sigma, cosSqAlpha, cos2SigmaM;
+    int iterations = 0;
+    do {
+        double sinLambda = sin(lambda), cosLambda = cos(lambda);
+        sinSigma = sqrt((cosU2 * sinLambda) * (cosU2 * sinLambda) +
+            (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda) * (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda));
+        if (sinSigma == 0) return 0; // same point
+        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+        sigma = atan2(sinSigma, cosSigma);
+        double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+        cosSqAlpha = 1 - sinAlpha * sinAlpha;
+        cos2SigmaM = cosSqAlpha != 0 ? cosSigma - 2 * sinU1 * sinU2 / cosSqAlpha : 0; // 0 on the equator
+        double C = f / 16 * cosSqAlpha * (4 + f * (4 - 3 * cosSqAlpha));
+        previous = lambda;
+        lambda = L + (1 - C) * f * sinAlpha * (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+    } while (fabs(lambda - previous) > 1e-12 && ++iterations < 200);
+
+    double uSq = cosSqAlpha * (a * a - b * b) / (b * b);
+    double A = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq)));
+    double B = uSq / 1024 * (256 + uSq * (-128 + uSq * (74 - 47 * uSq)));
+    double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+        B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+
+    return b * A * (sigma - deltaSigma); // distance in km
+}
+
 
 ///////////////////////////////////////// Linked List /////////////////////////////////////////
 
@@ -73,9 +363,11 @@ class LinkedList {
     public:
 
         Node* head;
+        Node* tail; // last node, so that loading a large map appends in O(1)
 
         LinkedList() {
             head = NULL;
+            tail = NULL;
         }
 
         void addNode(string city, float latitude, float longitude) {
@@ -84,12 +376,9 @@ class LinkedList {
                 head = new_node;
             }
             else {
-                Node* temp = head;
-                while (temp->next != NULL) {
-                    temp = temp->next;
-                }
-                temp->next = new_node;
+                tail->next = new_node;
             }
+            tail = new_node;
         }
 
         Node* searchCity(string city) {
@@ -124,19 +413,24 @@ class LinkedList {
 
 ///////////////////////////////////////// Graph /////////////////////////////////////////
 
+class Road;
+
 class Vertex {
     public:
+        int id; // position in the graph's vertex list
         string city;
         float latitude;
         float longitude;
         vector<Vertex*> neighbors; // list of neighboring cities (adjacent vertices)
+        vector<Road*> roads;       // road leading to each neighbor (parallel to neighbors)
 
         float shortestDistance;
         bool visited;
         bool settled;
         vector<Vertex*> shortestPath;
 
-        Vertex(string city, float latitude, float longitude) {
+        Vertex(int id, string city, float latitude, float longitude) {
+            this->id = id;
             this->city = city;
             this->latitude = latitude;
             this->longitude = longitude;
@@ -145,13 +439,23 @@ class Vertex {
             this->settled = false;
         }
 
-        void addNeighbor(Vertex* neighbor) {
+        void addNeighbor(Vertex* neighbor, Road* road) {
             for (int i = 0; i < neighbors.size(); i++) {  // check if the neighbor is already in the list to prevent duplicates
                 if (neighbors[i] == neighbor) {
                     return;  // neighbor is already added
                 }
             }
             neighbors.push_back(neighbor);
+            roads.push_back(road);
+        }
+
+        Road* getRoadTo(Vertex* neighbor) {
+            for (int i = 0; i < neighbors.size(); i++) {
+                if (neighbors[i] == neighbor) {
+                    return roads[i];
+                }
+            }
+            return NULL; // not adjacent
         }
 
         double calculateDistance(Vertex* other) {
@@ -159,13 +463,51 @@ class Vertex {
         }
 };
 
+// an undirected road between two cities, shared by both endpoints' adjacency lists
+class Road {
+    public:
+        int id; // position in the graph's road list
+        Vertex* from;
+        Vertex* to;
+        float distance; // length in km, the haversine distance unless the road has been reweighted
+        float toll;     // Rs. charged on top of the per km fare
+        float speed;    // expected speed in km/h
+        bool open;      // closed roads stay in the adjacency lists but are skipped by every search
+
+        Road(int id, Vertex* from, Vertex* to, float distance) {
+            this->id = id;
+            this->from = from;
+            this->to = to;
+            this->distance = distance;
+            this->toll = 0;
+            this->speed = average_speed;
+            this->open = true;
+        }
+
+        Vertex* otherEnd(Vertex* v) {
+            return v == from ? to : from;
+        }
+};
+
 class Graph {
     private:
         vector<Vertex*> vertices;
+        vector<Road*> roads;
 
     public:
+        vector<pair<string, string>> danglingEdges; // addEdge calls naming a city that does not exist
+
+        Graph() = default;
+        Graph(const Graph&) = delete; // owns its vertices and roads
+        Graph& operator=(const Graph&) = delete;
+
+        ~Graph() {
+            for (int i = 0; i < vertices.size(); i++) delete vertices[i];
+            for (int i = 0; i < roads.size(); i++) delete roads[i];
+        }
+
         void addVertex(string city, float latitude, float longitude) {
-            Vertex* newCity = new Vertex(city, latitude, longitude);
+            Vertex* newCity = new Vertex(vertices.size(), city, latitude, longitude);
             vertices.push_back(newCity);
         }
 
@@ -179,14 +521,101 @@ class Graph {
             return NULL; // city not found
         }
 
+        Vertex* getVertex(int id) {
+            return vertices[id];
+        }
+
+        int vertexCount() {
+            return vertices.size();
+        }
+
+        Road* getRoad(int id) {
+            return roads[id];
+        }
+
+        Road* getRoad(string city1, string city2) {
+            Vertex* v1 = getVertex(city1);
+            Vertex* v2 = getVertex(city2);
+
+            if (v1 == NULL || v2 == NULL) {
+                return NULL; // city not found
+            }
+            return v1->getRoadTo(v2);
+        }
+
+        int roadCount() {
+            return roads.size();
+        }
+
         void addEdge(string city1, string city2) {
             Vertex* v1 = getVertex(city1);
             Vertex* v2 = getVertex(city2);
 
             if (v1 != NULL && v2 != NULL) { // no object as such exists
-                v1->addNeighbor(v2);        // add v2 as a neighbor of v1
-                v2->addNeighbor(v1);        // add v1 as a neighbor of v2 (for undirected graph)
+                addEdge(v1, v2);
+            }
+            else {
+                danglingEdges.push_back(make_pair(city1, city2));
+            }
+        }
+
+        Road* addEdge(Vertex* v1, Vertex* v2) {
+            Road* road = v1->getRoadTo(v2);
+            if (road != NULL) {
+                return road; // road already added from the other end
+            }
+            road = new Road(roads.size(), v1, v2, v1->calculateDistance(v2));
+            roads.push_back(road);
+            v1->addNeighbor(v2, road);  // add v2 as a neighbor of v1
+            v2->addNeighbor(v1, road);  // add v1 as a neighbor of v2 (for undirected graph)
+            return road;
+        }
+
+        // closes the road, it keeps its length so that it can be restored later
+        bool removeEdge(string city1, string city2) {
+            Road* road = getRoad(city1, city2);
+            if (road == NULL || !road->open) {
+                return false; // no such open road
+            }
+            road->open = false;
+            return true;
+        }
+
+        // reopens a road closed by removeEdge
+        bool restoreEdge(string city1, string city2) {
+            Road* road = getRoad(city1, city2);
+            if (road == NULL || road->open) {
+                return false; // no such closed road
+            }
+            road->open = true;
+            return true;
+        }
+
+        bool setEdgeWeight(string city1, string city2, float distance) {
+            Road* road = getRoad(city1, city2);
+            if (road == NULL || distance < 0) {
+                return false;
+            }
+            road->distance = distance;
+            return true;
+        }
+
+        bool setEdgeToll(string city1, string city2, float toll) {
+            Road* road = getRoad(city1, city2);
+            if (road == NULL || toll < 0) {
+                return false;
+            }
+            road->toll = toll;
+            return true;
+        }
+
+        bool setEdgeSpeed(string city1, string city2, float speed) {
+            Road* road = getRoad(city1, city2);
+            if (road == NULL || speed <= 0) {
+                return false;
             }
+            road->speed = speed;
+            return true;
         }
 
         void displayAdjacencyList() {
@@ -194,13 +623,171 @@ class Graph {
                 Vertex* v = vertices[i];
                 cout << v->city << " | ";
                 for (int j = 0; j < v->neighbors.size(); j++)
-                    cout << v->neighbors[j]->city << " ";
+                    if (v->roads[j]->open)
+                        cout << v->neighbors[j]->city << " ";
                 cout << endl;
             }
         }
 };
 
 
+///////////////////////////////////////// Distance Policies /////////////////////////////////////////
+
+// compile time choice of how a road is weighed, the searches are templates over the policy so that its
+// static weight() is inlined into the relaxation loop. errors are relative to vincenty(), worst case over
+// the roads (up to 266 km) and over all city pairs (up to 1452 km) of the map of Pakistan:
+//
+//   policy            roads     city pairs   anywhere
+//   HaversineFloat    0.369 %   0.373 %      0.56 %, the spherical earth model dominates
+//   HaversineDouble   0.369 %   0.374 %      0.56 %, float rounding and the rounded pi add < 0.001 %
+//   Equirectangular   0.369 %   0.374 %      grows with length and latitude: +0.004 % on roads, +0.13 % on 1450 km pairs
+//   RoadLength        stored length, exact to whatever the road data says (the HaversineFloat length by default)
+
+class HaversineFloat {
+    public:
+        static float weight(Road* road) {
+            return haversine(road->from->latitude, road->from->longitude, road->to->latitude, road->to->longitude);
+        }
+};
+
+class HaversineDouble {
+    public:
+        static float weight(Road* road) {
+            return haversineDouble(road->from->latitude, road->from->longitude, road->to->latitude, road->to->longitude);
+        }
+};
+
+class Equirectangular {
+    public:
+        static float weight(Road* road) {
+            return equirectangular(road->from->latitude, road->from->longitude, road->to->latitude, road->to->longitude);
+        }
+};
+
+class RoadLength {
+    public:
+        static float weight(Road* road) {
+            return road->distance;
+        }
+};
+
+// adapter for weights computed at run time (see Metrics), indexed by road id
+class RoadWeights {
+    public:
+        const vector<float>* weights;
+
+        RoadWeights(const vector<float>& weights) {
+            this->weights = &weights;
+        }
+
+        float weight(Road* road) const {
+            return (*weights)[road->id];
+        }
+};
+
+// worst relative error of a policy against vincenty() over the roads of the graph, to pick one per deployment
+template <class Policy>
+double maxRelativeError(Graph& graph) {
+    double worst = 0;
+    for (int i = 0; i < graph.roadCount(); i++) {
+        Road* road = graph.getRoad(i);
+        double reference = vincenty(road->from->latitude, road->from->longitude, road->to->latitude, road->to->longitude);
+        if (reference > 0) {
+            worst = max(worst, fabs(Policy::weight(road) - reference) / reference);
+        }
+    }
+    return worst;
+}
+
+
+///////////////////////////////////////// Metrics /////////////////////////////////////////
+
+// weight vectors indexed by road id, closed roads weigh (true) infinity so that they never win a comparison
+class Metrics {
+    public:
+        template <class Policy = RoadLength>
+        static vector<float> distance(Graph& graph) { // km
+            TRACE_SPAN("weights distance");
+            vector<float> weights(graph.roadCount());
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                weights[i] = road->open ? Policy::weight(road) : numeric_limits<float>::infinity();
+            }
+            return weights;
+        }
+
+        static vector<float> travelTime(Graph& graph) { // minutes
+            TRACE_SPAN("weights travelTime");
+            vector<float> weights(graph.roadCount());
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                weights[i] = road->open ? road->distance / road->speed * 60 : numeric_limits<float>::infinity();
+            }
+            return weights;
+        }
+
+        static vector<float> fare(Graph& graph, int cost_per_KM) { // Rs., distance based fare plus tolls
+            TRACE_SPAN("weights fare");
+            vector<float> weights(graph.roadCount());
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                weights[i] = road->open ? road->distance * cost_per_KM + road->toll : numeric_limits<float>::infinity();
+            }
+            return weights;
+        }
+};
+
+
+///////////////////////////////////////// Compact Graph /////////////////////////////////////////
+
+// read-only adjacency arrays (CSR) of the open roads under one metric, both directions of every road.
+// arcs of a city are sorted by weight so that the light ones (up to some threshold) form a prefix
+class CompactGraph {
+    public:
+        int vertexCount;
+        vector<int> firstArc;    // arcs of vertex v are firstArc[v] .. firstArc[v + 1] - 1
+        vector<int> arcHead;     // vertex id the arc leads to
+        vector<int> arcRoad;     // road id of the arc
+        vector<float> arcWeight;
+
+        CompactGraph(Graph& graph, const vector<float>& weights) {
+            TRACE_SPAN("compact graph");
+            vertexCount = graph.vertexCount();
+            firstArc.assign(vertexCount + 1, 0);
+
+            for (int v = 0; v < vertexCount; v++) {
+                Vertex* vertex = graph.getVertex(v);
+                vector<pair<float, int>> arcs; // (weight, position in the adjacency list)
+                for (int i = 0; i < vertex->neighbors.size(); i++) {
+                    Road* road = vertex->roads[i];
+                    if (road->open && weights[road->id] < numeric_limits<float>::infinity()) {
+                        arcs.push_back(make_pair(weights[road->id], i));
+                    }
+                }
+                sort(arcs.begin(), arcs.end());
+
+                for (int i = 0; i < arcs.size(); i++) {
+                    arcHead.push_back(vertex->neighbors[arcs[i].second]->id);
+                    arcRoad.push_back(vertex->roads[arcs[i].second]->id);
+                    arcWeight.push_back(arcs[i].first);
+                }
+                firstArc[v + 1] = arcHead.size();
+            }
+        }
+
+        // first arc of v heavier than the threshold
+        int firstHeavyArc(int v, float threshold) {
+            return upper_bound(arcWeight.begin() + firstArc[v], arcWeight.begin() + firstArc[v + 1], threshold) - arcWeight.begin();
+        }
+
+        float averageArcWeight() {
+            double total = 0;
+            for (int a = 0; a < arcWeight.size(); a++) total += arcWeight[a];
+            return arcWeight.empty() ? 1 : total / arcWeight.size();
+        }
+};
+
+
 ///////////////////////////////////////// Min Heap Binary Tree /////////////////////////////////////////
 
 class MinHeap {
@@ -265,11 +852,116 @@ class MinHeap {
         }
 };
 
+// heap of (distance, vertex id) entries for the searches that keep their state outside the vertices,
+// a vertex may be inserted more than once, stale entries are skipped by the caller
+class DistanceHeap {
+    private:
+        vector<pair<float, int>> heap;
+
+        int getParent(int index) { return (index - 1) / 2; }
+        int getLeftChild(int index) { return 2 * index + 1; }
+        int getRightChild(int index) { return 2 * index + 2; }
+
+        void heapifyUp(int index) { // insertion
+            while (index > 0 && heap[index].first < heap[getParent(index)].first) {
+                swap(heap[index], heap[getParent(index)]);
+                index = getParent(index);
+            }
+        }
+
+        void heapifyDown(int index) { // extraction
+            while (true) {
+                int leftChild = getLeftChild(index);
+                int rightChild = getRightChild(index);
+                int smallest = index;
+
+                if (leftChild < heap.size() && heap[leftChild].first < heap[smallest].first)
+                    smallest = leftChild;
+
+                if (rightChild < heap.size() && heap[rightChild].first < heap[smallest].first)
+                    smallest = rightChild;
+
+                if (smallest == index) return;
+                swap(heap[index], heap[smallest]);
+                index = smallest;
+            }
+        }
+
+    public:
+        void insert(int vertex, float distance) {
+            heap.push_back(make_pair(distance, vertex));
+            heapifyUp(heap.size() - 1);
+        }
+
+        pair<float, int> extractMin() { // (distance, vertex id)
+            pair<float, int> minElement = heap[0];
+            heap[0] = heap.back();
+            heap.pop_back();
+            if (!heap.empty()) heapifyDown(0);
+            return minElement;
+        }
+
+        float minDistance() const {
+            return heap[0].first;
+        }
+
+        bool isEmpty() const {
+            return heap.empty();
+        }
+
+        int size() const {
+            return heap.size();
+        }
+
+        void clear() {
+            heap.clear();
+        }
+};
+
 
 ///////////////////////////////////////// Dijkstra /////////////////////////////////////////
 
+// distances and parent pointers from one source, indexed by vertex id
+class ShortestPathTree {
+    public:
+        int source;
+        vector<float> distance; // infinity if unreachable
+        vector<int> parent;     // previous vertex on the shortest path, -1 for the source and unreachable vertices
+        vector<int> parentRoad; // road from the parent, -1 likewise
+
+        ShortestPathTree() {
+            source = -1;
+        }
+
+        ShortestPathTree(int source, int vertexCount) {
+            this->source = source;
+            distance.assign(vertexCount, infinity);
+            parent.assign(vertexCount, -1);
+            parentRoad.assign(vertexCount, -1);
+            distance[source] = 0;
+        }
+
+        bool reaches(int target) {
+            return distance[target] < infinity;
+        }
+
+        vector<Vertex*> pathTo(Graph& graph, int target) { // O(V)
+            TRACE_SPAN("pathTo");
+            vector<Vertex*> path;
+            if (!reaches(target)) {
+                return path;
+            }
+            for (int v = target; v != -1; v = parent[v]) {
+                path.push_back(graph.getVertex(v));
+            }
+            reverse(path.begin(), path.end());
+            return path;
+        }
+};
+
 class Dijkstra {
     private:
+        template <class Policy>
         static void calculateShortestPath(Vertex* source) { // O(E*logV)
             source->shortestDistance = 0;
             MinHeap unsettledVertices;
@@ -284,181 +976,5302 @@ class Dijkstra {
 
                 for (int i = 0; i < currentVertex->neighbors.size(); i++) { // getting all unvisited neighbours for the current vertex 
                     Vertex* adjacentVertex = currentVertex->neighbors[i];
-                    if (!adjacentVertex->visited) {
+                    Road* road = currentVertex->roads[i];
+                    if (road->open && !adjacentVertex->visited) {
+
+                        // road length under the chosen policy, by default the stored length (haversine unless the road was reweighted)
+                        float edgeDistance = Policy::weight(road);
+                        evaluateDistanceAndPath(adjacentVertex, currentVertex, edgeDistance);
+                        if (!adjacentVertex->settled) {
+                            unsettledVertices.insert(adjacentVertex);
+                            adjacentVertex->settled = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        static vector<Vertex*> getPath(Vertex* destination) { // O(V)
+            TRACE_SPAN("getPath");
+            vector<Vertex*> paths = destination->shortestPath;
+            paths.push_back(destination);
+            return paths;
+        }
+
+        static void evaluateDistanceAndPath(Vertex* adjacentVertex, Vertex* sourceVertex, float edgeDistance) { // O(V)
+            float newDistance = sourceVertex->shortestDistance + edgeDistance;
+
+            if (newDistance < adjacentVertex->shortestDistance) {
+                adjacentVertex->shortestDistance = newDistance;
+                adjacentVertex->shortestPath = sourceVertex->shortestPath;
+                adjacentVertex->shortestPath.push_back(sourceVertex);
+            }
+        }
+
+        // one relaxation loop for every weight, Weight::weight(road) is resolved at compile time
+        template <class Weight>
+        static ShortestPathTree buildShortestPathTree(Graph& graph, Vertex* source, const Weight& weight) { // O(E*logV)
+            TRACE_SPAN("dijkstra heap loop");
+            ShortestPathTree tree(source->id, graph.vertexCount());
+            vector<bool> visited(graph.vertexCount(), false);
+            DistanceHeap unsettledVertices;
+
+            unsettledVertices.insert(source->id, 0);
+
+            while (!unsettledVertices.isEmpty()) {
+                int current = unsettledVertices.extractMin().second;
+
+                if (visited[current]) continue;
+                visited[current] = true;
+
+                Vertex* currentVertex = graph.getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || visited[adjacent]) continue;
+
+                    float newDistance = tree.distance[current] + weight.weight(road);
+                    if (newDistance < tree.distance[adjacent]) {
+                        tree.distance[adjacent] = newDistance;
+                        tree.parent[adjacent] = current;
+                        tree.parentRoad[adjacent] = road->id;
+                        unsettledVertices.insert(adjacent, newDistance);
+                    }
+                }
+            }
+            return tree;
+        }
+
+    public:
+        template <class Policy = RoadLength>
+        static vector<Vertex*> getShortestPath(Vertex* from, Vertex* to) { // O(E*logV)
+            calculateShortestPath<Policy>(from);
+            return getPath(to);
+        }
+
+        // same search as calculateShortestPath but leaves the vertices untouched, so it can be repeated and cached
+        template <class Policy = RoadLength>
+        static ShortestPathTree getShortestPathTree(Graph& graph, Vertex* source) { // O(E*logV)
+            return buildShortestPathTree(graph, source, Policy());
+        }
+
+        // shortest path tree under any metric, weights are indexed by road id
+        static ShortestPathTree getShortestPathTree(Graph& graph, Vertex* source, const vector<float>& weights) { // O(E*logV)
+            return buildShortestPathTree(graph, source, RoadWeights(weights));
+        }
+};
+
+
+///////////////////////////////////////// Dynamic Shortest Paths /////////////////////////////////////////
+
+// keeps cached shortest path trees (rows of a distance table) valid while roads are closed, reopened or reweighted.
+// only the vertices whose distance can change are touched (Ramalingam-Reps style):
+//  - a shorter or reopened road can only improve vertices reachable through it, so a Dijkstra is seeded at its endpoints
+//  - a longer or closed road only matters if it is a tree edge, then the subtree hanging below it is
+//    invalidated and reattached from its unaffected border
+// roads must be edited through this class for the cached trees to stay valid
+class DynamicShortestPaths {
+    private:
+        Graph* graph;
+        vector<ShortestPathTree> trees;
+        vector<bool> affected; // scratch marks for the invalidated subtree
+        int touched;           // vertices whose distance was recomputed by the last update
+
+        // propagates improvements from the seeded vertices, stale heap entries are skipped
+        void propagate(ShortestPathTree& tree, DistanceHeap& heap) { // O(k*logk) for k touched vertices
+            while (!heap.isEmpty()) {
+                pair<float, int> entry = heap.extractMin();
+                int current = entry.second;
+                if (entry.first > tree.distance[current]) continue; // stale entry
+                touched++;
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    if (!road->open) continue;
+
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    float newDistance = tree.distance[current] + road->distance;
+                    if (newDistance < tree.distance[adjacent]) {
+                        tree.distance[adjacent] = newDistance;
+                        tree.parent[adjacent] = current;
+                        tree.parentRoad[adjacent] = road->id;
+                        heap.insert(adjacent, newDistance);
+                    }
+                }
+            }
+        }
+
+        // the road became shorter or was reopened
+        void decrease(ShortestPathTree& tree, Road* road) {
+            DistanceHeap heap;
+            Vertex* ends[2] = { road->from, road->to };
+
+            for (int i = 0; i < 2; i++) {
+                int u = ends[i]->id;
+                int v = ends[1 - i]->id;
+                if (tree.distance[u] + road->distance < tree.distance[v]) {
+                    tree.distance[v] = tree.distance[u] + road->distance;
+                    tree.parent[v] = u;
+                    tree.parentRoad[v] = road->id;
+                    heap.insert(v, tree.distance[v]);
+                }
+            }
+            propagate(tree, heap);
+        }
+
+        // the road became longer or was closed
+        void increase(ShortestPathTree& tree, Road* road) {
+            int child = -1;
+            if (tree.parentRoad[road->to->id] == road->id) child = road->to->id;
+            if (tree.parentRoad[road->from->id] == road->id) child = road->from->id;
+            if (child == -1) {
+                return; // not a tree edge, no distance can change
+            }
+
+            // collect the subtree below the road by walking the parent pointers downwards
+            vector<int> subtree(1, child);
+            affected[child] = true;
+            for (int i = 0; i < subtree.size(); i++) {
+                Vertex* v = graph->getVertex(subtree[i]);
+                for (int j = 0; j < v->neighbors.size(); j++) {
+                    int w = v->neighbors[j]->id;
+                    if (!affected[w] && tree.parentRoad[w] == v->roads[j]->id) {
+                        affected[w] = true;
+                        subtree.push_back(w);
+                    }
+                }
+            }
+
+            for (int i = 0; i < subtree.size(); i++) {
+                tree.distance[subtree[i]] = infinity;
+                tree.parent[subtree[i]] = -1;
+                tree.parentRoad[subtree[i]] = -1;
+            }
+
+            // reattach every invalidated vertex to its best unaffected neighbor, then let dijkstra settle the rest
+            DistanceHeap heap;
+            for (int i = 0; i < subtree.size(); i++) {
+                int v = subtree[i];
+                Vertex* vertex = graph->getVertex(v);
+                for (int j = 0; j < vertex->neighbors.size(); j++) {
+                    Road* r = vertex->roads[j];
+                    int w = vertex->neighbors[j]->id;
+                    if (!r->open || affected[w]) continue;
+
+                    if (tree.distance[w] + r->distance < tree.distance[v]) {
+                        tree.distance[v] = tree.distance[w] + r->distance;
+                        tree.parent[v] = w;
+                        tree.parentRoad[v] = r->id;
+                    }
+                }
+                if (tree.distance[v] < infinity) {
+                    heap.insert(v, tree.distance[v]);
+                }
+            }
+
+            for (int i = 0; i < subtree.size(); i++) {
+                affected[subtree[i]] = false;
+            }
+            propagate(tree, heap);
+        }
+
+    public:
+        DynamicShortestPaths(Graph& graph) {
+            this->graph = &graph;
+            affected.assign(graph.vertexCount(), false);
+            touched = 0;
+        }
+
+        // caches the shortest path tree of the city, returns false if the city does not exist
+        bool addSource(string city) {
+            Vertex* source = graph->getVertex(city);
+            if (source == NULL) {
+                return false;
+            }
+            if (getTree(city) == NULL) {
+                trees.push_back(Dijkstra::getShortestPathTree(*graph, source));
+            }
+            return true;
+        }
+
+        ShortestPathTree* getTree(string city) {
+            Vertex* source = graph->getVertex(city);
+            for (int i = 0; source != NULL && i < trees.size(); i++) {
+                if (trees[i].source == source->id) {
+                    return &trees[i];
+                }
+            }
+            return NULL; // not a cached source
+        }
+
+        // distance table lookup, infinity if either city is unknown or not a cached source
+        float getDistance(string from, string to) {
+            ShortestPathTree* tree = getTree(from);
+            Vertex* destination = graph->getVertex(to);
+            if (tree == NULL || destination == NULL) {
+                return infinity;
+            }
+            return tree->distance[destination->id];
+        }
+
+        int lastTouched() {
+            return touched;
+        }
+
+        bool closeRoad(string city1, string city2) {
+            if (!graph->removeEdge(city1, city2)) {
+                return false;
+            }
+            Road* road = graph->getRoad(city1, city2);
+            touched = 0;
+            for (int i = 0; i < trees.size(); i++) {
+                increase(trees[i], road);
+            }
+            return true;
+        }
+
+        bool reopenRoad(string city1, string city2) {
+            if (!graph->restoreEdge(city1, city2)) {
+                return false;
+            }
+            Road* road = graph->getRoad(city1, city2);
+            touched = 0;
+            for (int i = 0; i < trees.size(); i++) {
+                decrease(trees[i], road);
+            }
+            return true;
+        }
+
+        bool reweightRoad(string city1, string city2, float distance) {
+            Road* road = graph->getRoad(city1, city2);
+            if (road == NULL) {
+                return false;
+            }
+            float oldDistance = road->distance;
+            if (!graph->setEdgeWeight(city1, city2, distance)) {
+                return false;
+            }
+
+            touched = 0;
+            if (!road->open || distance == oldDistance) {
+                return true; // nothing cached goes through it
+            }
+            for (int i = 0; i < trees.size(); i++) {
+                if (distance < oldDistance) decrease(trees[i], road);
+                else increase(trees[i], road);
+            }
+            return true;
+        }
+};
+
+
+///////////////////////////////////////// Connected Components /////////////////////////////////////////
+
+// component label of every city over the open roads, computed once so that unreachable destinations
+// are answered without a search. recompute after closing or reopening roads
+class ConnectedComponents {
+    private:
+        vector<int> label;
+        vector<int> sizes;
+
+    public:
+        ConnectedComponents(Graph& graph) { // O(V+E)
+            TRACE_SPAN("connected components");
+            label.assign(graph.vertexCount(), -1);
+            for (int start = 0; start < graph.vertexCount(); start++) {
+                if (label[start] != -1) continue;
+
+                int component = sizes.size();
+                sizes.push_back(0);
+                vector<int> stack(1, start);
+                label[start] = component;
+                while (!stack.empty()) {
+                    Vertex* v = graph.getVertex(stack.back());
+                    stack.pop_back();
+                    sizes[component]++;
+                    for (int i = 0; i < v->neighbors.size(); i++) {
+                        int w = v->neighbors[i]->id;
+                        if (v->roads[i]->open && label[w] == -1) {
+                            label[w] = component;
+                            stack.push_back(w);
+                        }
+                    }
+                }
+            }
+        }
+
+        int componentOf(Vertex* v) {
+            return label[v->id];
+        }
+
+        bool connected(Vertex* v1, Vertex* v2) { // O(1)
+            return label[v1->id] == label[v2->id];
+        }
+
+        int componentCount() {
+            return sizes.size();
+        }
+
+        int componentSize(int component) {
+            return sizes[component];
+        }
+};
+
+// problems found while loading the map
+class IntegrityReport {
+    public:
+        vector<string> missingCities;               // in the city list but not in the graph
+        vector<pair<string, string>> danglingEdges; // roads naming a city that does not exist
+        vector<string> isolatedCities;              // no open road at all
+        int components;
+
+        IntegrityReport(LinkedList& cities, Graph& graph, ConnectedComponents& componentLabels) {
+            for (Node* node = cities.head; node != NULL; node = node->next) {
+                if (graph.getVertex(node->city) == NULL) {
+                    missingCities.push_back(node->city);
+                }
+            }
+            danglingEdges = graph.danglingEdges;
+            for (int i = 0; i < graph.vertexCount(); i++) {
+                if (componentLabels.componentSize(componentLabels.componentOf(graph.getVertex(i))) == 1) {
+                    isolatedCities.push_back(graph.getVertex(i)->city);
+                }
+            }
+            components = componentLabels.componentCount();
+        }
+
+        bool isClean() {
+            return missingCities.empty() && danglingEdges.empty() && isolatedCities.empty() && components <= 1;
+        }
+
+        void display() {
+            cout << "MAP INTEGRITY REPORT" << endl;
+            for (int i = 0; i < missingCities.size(); i++) {
+                cout << "Missing city: " << missingCities[i] << endl;
+            }
+            for (int i = 0; i < danglingEdges.size(); i++) {
+                cout << "Road to unknown city: " << danglingEdges[i].first << " - " << danglingEdges[i].second << endl;
+            }
+            for (int i = 0; i < isolatedCities.size(); i++) {
+                cout << "Isolated city: " << isolatedCities[i] << endl;
+            }
+            cout << "Connected components: " << components << endl;
+        }
+};
+
+
+///////////////////////////////////////// City Name Index /////////////////////////////////////////
+
+// trie over the normalized city names (lowercase, single spaces) stored in flat arrays without pointers:
+// children of a node are contiguous (breadth first layout) and sorted by character, and since the names are
+// sorted every node also covers a contiguous range of them, the names starting with its prefix
+class CityIndex {
+    private:
+        vector<pair<string, int>> names; // (normalized name, vertex id), sorted
+        vector<char> label;              // character on the edge into the node
+        vector<int> firstChild;
+        vector<int> childCount;
+        vector<int> firstName;           // names of the node's subtree are firstName .. lastName - 1
+        vector<int> lastName;
+        vector<int> depth;
+        Graph* graph;
+
+        int child(int node, char c) { // O(log alphabet)
+            int begin = firstChild[node], end = firstChild[node] + childCount[node];
+            while (begin < end) {
+                int middle = (begin + end) / 2;
+                if (label[middle] < c) begin = middle + 1;
+                else end = middle;
+            }
+            return (begin < firstChild[node] + childCount[node] && label[begin] == c) ? begin : -1;
+        }
+
+        int findNode(const string& key) {
+            int node = 0;
+            for (int i = 0; i < key.size() && node != -1; i++) {
+                node = child(node, key[i]);
+            }
+            return node;
+        }
+
+        // names ending exactly at the node come first in its range
+        int namesEndingAt(int node) {
+            int count = 0;
+            for (int i = firstName[node]; i < lastName[node] && names[i].first.size() == depth[node]; i++) count++;
+            return count;
+        }
+
+        // depth first walk keeping one row of the levenshtein table per level, pruned once the whole row exceeds maxEdits
+        void suggestFrom(int node, const string& key, const vector<int>& row, int maxEdits, vector<pair<int, int>>& found) {
+            int ending = namesEndingAt(node);
+            if (ending > 0 && row.back() <= maxEdits) {
+                for (int i = 0; i < ending; i++) found.push_back(make_pair(row.back(), names[firstName[node] + i].second));
+            }
+
+            for (int c = firstChild[node]; c < firstChild[node] + childCount[node]; c++) {
+                vector<int> next(row.size());
+                next[0] = row[0] + 1;
+                int best = next[0];
+                for (int j = 1; j < row.size(); j++) {
+                    int substitution = row[j - 1] + (key[j - 1] == label[c] ? 0 : 1);
+                    next[j] = min(substitution, min(row[j] + 1, next[j - 1] + 1));
+                    best = min(best, next[j]);
+                }
+                if (best <= maxEdits) {
+                    suggestFrom(c, key, next, maxEdits, found);
+                }
+            }
+        }
+
+    public:
+        static string normalize(const string& name) {
+            string key;
+            for (int i = 0; i < name.size(); i++) {
+                char c = tolower((unsigned char)name[i]);
+                if (isspace((unsigned char)c)) {
+                    if (!key.empty() && key.back() != ' ') key += ' ';
+                }
+                else {
+                    key += c;
+                }
+            }
+            if (!key.empty() && key.back() == ' ') key.pop_back();
+            return key;
+        }
+
+        CityIndex(Graph& graph) { // O(L*log(V)) for L characters in all names
+            TRACE_SPAN("city index");
+            this->graph = &graph;
+            for (int i = 0; i < graph.vertexCount(); i++) {
+                names.push_back(make_pair(normalize(graph.getVertex(i)->city), i));
+            }
+            sort(names.begin(), names.end());
+
+            // breadth first: a node's children are appended together, grouped by their character
+            label.push_back('\0');
+            firstChild.push_back(0);
+            childCount.push_back(0);
+            firstName.push_back(0);
+            lastName.push_back(names.size());
+            depth.push_back(0);
+            for (int node = 0; node < label.size(); node++) {
+                firstChild[node] = label.size();
+                int d = depth[node];
+                int i = firstName[node];
+                while (i < lastName[node] && names[i].first.size() == d) i++;
+                while (i < lastName[node]) {
+                    char c = names[i].first[d];
+                    int begin = i;
+                    while (i < lastName[node] && names[i].first[d] == c) i++;
+                    label.push_back(c);
+                    firstChild.push_back(0);
+                    childCount.push_back(0);
+                    firstName.push_back(begin);
+                    lastName.push_back(i);
+                    depth.push_back(d + 1);
+                    childCount[node]++;
+                }
+            }
+        }
+
+        // case and spacing insensitive exact match, NULL if there is none
+        Vertex* find(const string& name) { // O(length*log alphabet)
+            int node = findNode(normalize(name));
+            if (node == -1 || namesEndingAt(node) == 0) {
+                return NULL;
+            }
+            return graph->getVertex(names[firstName[node]].second);
+        }
+
+        // cities whose name starts with the prefix, alphabetically
+        vector<Vertex*> autocomplete(const string& prefix, int limit) { // O(length*log alphabet + limit)
+            vector<Vertex*> matches;
+            int node = findNode(normalize(prefix));
+            for (int i = (node == -1 ? 0 : firstName[node]); node != -1 && i < lastName[node] && matches.size() < limit; i++) {
+                matches.push_back(graph->getVertex(names[i].second));
+            }
+            return matches;
+        }
+
+        // cities within maxEdits insertions, deletions or substitutions of the name, closest first
+        vector<Vertex*> suggest(const string& name, int maxEdits, int limit) {
+            string key = normalize(name);
+            vector<int> row(key.size() + 1);
+            for (int j = 0; j <= key.size(); j++) row[j] = j;
+
+            vector<pair<int, int>> found; // (edits, vertex id)
+            suggestFrom(0, key, row, maxEdits, found);
+            stable_sort(found.begin(), found.end(), [](const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; });
+
+            vector<Vertex*> suggestions;
+            for (int i = 0; i < found.size() && suggestions.size() < limit; i++) {
+                suggestions.push_back(graph->getVertex(found[i].second));
+            }
+            return suggestions;
+        }
+
+        int nodeCount() {
+            return label.size();
+        }
+};
+
+
+///////////////////////////////////////// Passenger /////////////////////////////////////////
+
+class Passenger {
+    public:
+        int ID;
+        string name;
+        char passenger_type;
+
+        Passenger()
+        {
+            ID = 0;
+            name = "";
+            passenger_type = '\0';
+        }
+
+        Passenger(int ID, string name, char passenger_type) {
+            this->ID = ID;
+            this->name = name;
+            this->passenger_type = passenger_type;
+        }
+
+        void display_details() {
+            string category;
+
+            cout << "Passenger ID = " << ID << endl;
+            cout << "Passenger name = " << name << endl;
+
+            if (passenger_type == 'A' || passenger_type == 'a') {
+                category = "Adult";
+            }
+            else if (passenger_type == 'S' || passenger_type == 's') {
+                category = "Student";
+            }
+            else if (passenger_type == 'E' || passenger_type == 'e') {
+                category = "Elderly";
+            }
+            else {
+                category = "Default Adult";
+            }
+            cout << "Passenger category = " << category << endl;
+            
+        }
+
+        virtual void cost_cal(float distance, int cost_per_KM) = 0;
+};
+
+class Student : public Passenger {
+    public:
+        Student(int ID, string name, char passenger_type) {
+            this->ID = ID;
+            this->name = name;
+            this->passenger_type = passenger_type;
+        }
+
+        void cost_cal(float distance, int cost_per_KM) override {
+            float cost = distance * cost_per_KM;
+            cout << "Price before student discount = Rs. " << cost << endl;
+            cost = cost - (cost * 0.5);
+            cout << "Total cost after student discount (50 %) = Rs. " << cost << endl;
+        }
+};
+
+class Adult : public Passenger {
+    public:
+        Adult(int ID, string name, char passenger_type) {
+            this->ID = ID;
+            this->name = name;
+            this->passenger_type = passenger_type;
+        }
+
+        void cost_cal(float distance, int cost_per_KM) override {
+            float cost = distance * cost_per_KM;
+            cout << "No discount applicable :(" << endl;
+            cout << "Total cost = Rs. " << cost << endl;
+        }
+};
+
+class Elderly : public Passenger {
+    public:
+        Elderly(int ID, string name, char passenger_type) {
+            this->ID = ID;
+            this->name = name;
+            this->passenger_type = passenger_type;
+        }
+
+        void cost_cal(float distance, int cost_per_KM) override {
+            float cost = distance * cost_per_KM;
+            cout << "Price before elderly discount = Rs. " << cost << endl;
+            cost = cost - (cost * 0.8);
+            cout << "Total cost after elderly discount (80 %) = Rs. " << cost << endl;
+        }
+};
+
+class Vehicle {
+    protected:
+        int cost_per_KM;
+
+    public:
+        Vehicle() {
+            cost_per_KM = 0;
+        }
+        Vehicle(int cost) {
+            cost_per_KM = cost;
+        }
+        int get_cost_per_KM() {
+            return cost_per_KM; 
+        }
+};
+
+class Mini : public Vehicle {
+    public:
+        static const int rate = 20;
+
+        Mini() {
+            cost_per_KM = rate;
+            cout << "Mini Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        }
+};
+
+class Standard : public Vehicle {
+    public:
+        static const int rate = 50;
+
+        Standard() {
+            cost_per_KM = rate;
+            cout << "Standard Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        }
+};
+
+class Luxury : public Vehicle {
+    public:
+        static const int rate = 100;
+
+        Luxury() {
+            cost_per_KM = rate;
+            cout << "Luxury Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        }
+};
+
+// vehicle tiers in menu order, for pricing routes without constructing (and announcing) a vehicle
+const int vehicle_tiers = 3;
+const string vehicle_tier_names[vehicle_tiers] = { "Mini", "Standard", "Luxury" };
+const int vehicle_tier_rates[vehicle_tiers] = { Mini::rate, Standard::rate, Luxury::rate };
+
+
+///////////////////////////////////////// Geometric Partitioning /////////////////////////////////////////
+
+class InertialBisection {
+    public:
+        // splits the cities into two halves of equal size along the principal axis of their coordinates,
+        // roads mostly join nearby cities so a straight cut through the point cloud crosses few of them
+        static void split(Graph& graph, const vector<int>& cell, vector<int>& left, vector<int>& right) { // O(V)
+            int n = cell.size();
+            double meanLat = 0, meanLon = 0;
+            for (int i = 0; i < n; i++) {
+                meanLat += graph.getVertex(cell[i])->latitude;
+                meanLon += graph.getVertex(cell[i])->longitude;
+            }
+            meanLat /= n;
+            meanLon /= n;
+
+            // project to a local plane so that a degree of longitude and of latitude weigh the same distance
+            double scale = cos(deg2rad(meanLat));
+            double xx = 0, xy = 0, yy = 0;
+            for (int i = 0; i < n; i++) {
+                double x = (graph.getVertex(cell[i])->longitude - meanLon) * scale;
+                double y = graph.getVertex(cell[i])->latitude - meanLat;
+                xx += x * x;
+                xy += x * y;
+                yy += y * y;
+            }
+
+            // principal eigenvector of the 2x2 covariance matrix
+            double angle = 0.5 * atan2(2 * xy, xx - yy);
+            double dx = cos(angle), dy = sin(angle);
+
+            vector<pair<double, int>> projection(n);
+            for (int i = 0; i < n; i++) {
+                double x = (graph.getVertex(cell[i])->longitude - meanLon) * scale;
+                double y = graph.getVertex(cell[i])->latitude - meanLat;
+                projection[i] = make_pair(x * dx + y * dy, cell[i]);
+            }
+            nth_element(projection.begin(), projection.begin() + n / 2, projection.end());
+
+            left.clear();
+            right.clear();
+            for (int i = 0; i < n; i++) {
+                if (i < n / 2) left.push_back(projection[i].second);
+                else right.push_back(projection[i].second);
+            }
+        }
+
+        // greedy boundary refinement of a split: moves cities whose roads mostly lead to the other half across,
+        // as long as both halves stay within the imbalance allowed
+        static void refine(Graph& graph, vector<int>& left, vector<int>& right, float imbalance = 0.05, int passes = 4) { // O(passes*E)
+            int n = left.size() + right.size();
+            int maxSide = min(n - 1, (int)ceil((1 + imbalance) * n / 2));
+            vector<int> side(graph.vertexCount(), -1);
+            for (int i = 0; i < left.size(); i++) side[left[i]] = 0;
+            for (int i = 0; i < right.size(); i++) side[right[i]] = 1;
+            int count[2] = { (int)left.size(), (int)right.size() };
+
+            for (int pass = 0; pass < passes; pass++) {
+                bool moved = false;
+                for (int s = 0; s < 2; s++) {
+                    vector<int>& part = s == 0 ? left : right;
+                    for (int i = 0; i < part.size(); i++) {
+                        Vertex* v = graph.getVertex(part[i]);
+                        int gain = 0;
+                        for (int j = 0; j < v->neighbors.size(); j++) {
+                            int other = side[v->neighbors[j]->id];
+                            if (other == 1 - s) gain++;
+                            else if (other == s) gain--;
+                        }
+                        if (gain > 0 && count[1 - s] < maxSide) {
+                            side[v->id] = 1 - s;
+                            count[s]--;
+                            count[1 - s]++;
+                            moved = true;
+                        }
+                    }
+                }
+                if (!moved) break;
+
+                vector<int> all(left);
+                all.insert(all.end(), right.begin(), right.end());
+                left.clear();
+                right.clear();
+                for (int i = 0; i < all.size(); i++) {
+                    if (side[all[i]] == 0) left.push_back(all[i]);
+                    else right.push_back(all[i]);
+                }
+            }
+        }
+};
+
+// nested cells on several levels from recursive bisection, level 1 is the finest.
+// a level l cell holds at most maxCellSizes[l - 1] cities and lies inside exactly one cell of every level above
+class MultiLevelPartition {
+    private:
+        void bisect(Graph& graph, vector<int>& cell, vector<bool> assigned) {
+            for (int level = 1; level <= levels; level++) {
+                if (!assigned[level - 1] && cell.size() <= maxCellSizes[level - 1]) {
+                    for (int i = 0; i < cell.size(); i++) cells[level - 1][cell[i]] = cellCount[level - 1];
+                    cellCount[level - 1]++;
+                    assigned[level - 1] = true;
+                }
+            }
+            if (assigned[0]) {
+                return; // reached the finest level
+            }
+
+            vector<int> left, right;
+            InertialBisection::split(graph, cell, left, right);
+            InertialBisection::refine(graph, left, right);
+            bisect(graph, left, assigned);
+            bisect(graph, right, assigned);
+        }
+
+    public:
+        int levels;
+        vector<int> maxCellSizes;
+        vector<vector<int>> cells; // cells[level - 1][vertex id]
+        vector<int> cellCount;     // cells per level
+
+        // maxCellSizes must be increasing, one entry per level
+        MultiLevelPartition(Graph& graph, const vector<int>& maxCellSizes) {
+            TRACE_SPAN("multi-level partition");
+            this->maxCellSizes = maxCellSizes;
+            levels = maxCellSizes.size();
+            cells.assign(levels, vector<int>(graph.vertexCount(), -1));
+            cellCount.assign(levels, 0);
+
+            vector<int> all(graph.vertexCount());
+            for (int i = 0; i < all.size(); i++) all[i] = i;
+            bisect(graph, all, vector<bool>(levels, false));
+        }
+
+        int cellOf(int level, int vertex) {
+            return cells[level - 1][vertex];
+        }
+
+        // roads between different cells of the level
+        int cutSize(Graph& graph, int level) {
+            int cut = 0;
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                if (cellOf(level, road->from->id) != cellOf(level, road->to->id)) cut++;
+            }
+            return cut;
+        }
+};
+
+
+///////////////////////////////////////// Customizable Contraction Hierarchy /////////////////////////////////////////
+
+// metric independent preprocessing (done once per road topology, closed roads included):
+//  1. nested dissection order from recursive inertial bisection, separators get the highest ranks
+//  2. contraction in that order, which adds the shortcuts of a chordal supergraph, and the lower triangles of every arc
+// customization (done per metric, a linear pass over the triangles):
+//  weight(u, w) = min(road weight, min over lower triangles v of weight(v, u) + weight(v, w))
+// everything below is indexed by rank, arcs point upwards and are grouped by their lower endpoint
+class ContractionHierarchy {
+    private:
+        void dissect(Graph& graph, vector<int>& cell, vector<int>& order, vector<char>& side) {
+            if (cell.size() <= 4) {
+                order.insert(order.end(), cell.begin(), cell.end());
+                return;
+            }
+
+            vector<int> left, right;
+            InertialBisection::split(graph, cell, left, right);
+            for (int i = 0; i < right.size(); i++) side[right[i]] = 1;
+
+            // left cities with a road into the right half separate the halves
+            vector<int> remaining, separator;
+            for (int i = 0; i < left.size(); i++) {
+                Vertex* v = graph.getVertex(left[i]);
+                bool cut = false;
+                for (int j = 0; j < v->neighbors.size() && !cut; j++) {
+                    cut = side[v->neighbors[j]->id] == 1;
+                }
+                if (cut) separator.push_back(left[i]);
+                else remaining.push_back(left[i]);
+            }
+            for (int i = 0; i < right.size(); i++) side[right[i]] = 0;
+
+            dissect(graph, remaining, order, side);
+            dissect(graph, right, order, side);
+            order.insert(order.end(), separator.begin(), separator.end());
+        }
+
+    public:
+        Graph* graph;
+        int vertexCount;
+        vector<int> rank;              // vertex id -> rank
+        vector<int> vertexOfRank;      // rank -> vertex id
+        vector<int> eliminationParent; // lowest ranked upper neighbor, -1 for roots of the elimination tree
+        vector<int> firstArc;          // upward arcs of rank r are firstArc[r] .. firstArc[r + 1] - 1
+        vector<int> arcTail;           // rank of the lower endpoint
+        vector<int> arcHead;           // rank of the upper endpoint
+        vector<int> arcRoad;           // road the arc stands for, -1 for shortcuts
+        vector<int> firstTriangle;     // lower triangles of arc a are firstTriangle[a] .. firstTriangle[a + 1] - 1
+        vector<pair<int, int>> triangles; // (arc v->u, arc v->w) under arc u->w
+
+        ContractionHierarchy(Graph& graph) {
+            TRACE_SPAN("contract hierarchy");
+            this->graph = &graph;
+            vertexCount = graph.vertexCount();
+
+            vector<int> cell(vertexCount);
+            for (int i = 0; i < vertexCount; i++) cell[i] = i;
+            vector<char> side(vertexCount, 0);
+            dissect(graph, cell, vertexOfRank, side);
+
+            rank.assign(vertexCount, 0);
+            for (int r = 0; r < vertexCount; r++) rank[vertexOfRank[r]] = r;
+
+            // contraction: the remaining upper neighbors of a contracted vertex become a clique,
+            // adding them to the lowest one is enough as it is contracted next among them
+            vector<vector<int>> up(vertexCount);
+            for (int i = 0; i < graph.roadCount(); i++) {
+                int a = rank[graph.getRoad(i)->from->id];
+                int b = rank[graph.getRoad(i)->to->id];
+                up[min(a, b)].push_back(max(a, b));
+            }
+            for (int r = 0; r < vertexCount; r++) {
+                sort(up[r].begin(), up[r].end());
+                up[r].erase(unique(up[r].begin(), up[r].end()), up[r].end());
+            }
+            eliminationParent.assign(vertexCount, -1);
+            for (int r = 0; r < vertexCount; r++) {
+                if (up[r].empty()) continue;
+
+                int p = up[r][0];
+                eliminationParent[r] = p;
+                vector<int> merged;
+                set_union(up[p].begin(), up[p].end(), up[r].begin() + 1, up[r].end(), back_inserter(merged));
+                up[p] = merged;
+            }
+
+            firstArc.assign(vertexCount + 1, 0);
+            for (int r = 0; r < vertexCount; r++) {
+                firstArc[r + 1] = firstArc[r] + up[r].size();
+                for (int i = 0; i < up[r].size(); i++) {
+                    Road* road = graph.getVertex(vertexOfRank[r])->getRoadTo(graph.getVertex(vertexOfRank[up[r][i]]));
+                    arcTail.push_back(r);
+                    arcHead.push_back(up[r][i]);
+                    arcRoad.push_back(road == NULL ? -1 : road->id);
+                }
+            }
+
+            // every pair of upper neighbors of v closes a triangle with the arc between them
+            vector<vector<pair<int, int>>> lower(arcTail.size());
+            for (int v = 0; v < vertexCount; v++) {
+                for (int i = firstArc[v]; i < firstArc[v + 1]; i++) {
+                    for (int j = i + 1; j < firstArc[v + 1]; j++) {
+                        int u = arcHead[i];
+                        int top = findArc(u, arcHead[j]);
+                        lower[top].push_back(make_pair(i, j));
+                    }
+                }
+            }
+            firstTriangle.assign(arcTail.size() + 1, 0);
+            for (int a = 0; a < lower.size(); a++) {
+                firstTriangle[a + 1] = firstTriangle[a] + lower[a].size();
+                triangles.insert(triangles.end(), lower[a].begin(), lower[a].end());
+            }
+        }
+
+        int findArc(int lowerRank, int upperRank) { // O(logd)
+            vector<int>::iterator begin = arcHead.begin() + firstArc[lowerRank];
+            vector<int>::iterator end = arcHead.begin() + firstArc[lowerRank + 1];
+            vector<int>::iterator it = lower_bound(begin, end, upperRank);
+            return (it != end && *it == upperRank) ? it - arcHead.begin() : -1;
+        }
+
+        int arcCount() {
+            return arcTail.size();
+        }
+
+        int shortcutCount() {
+            int shortcuts = 0;
+            for (int a = 0; a < arcRoad.size(); a++) {
+                if (arcRoad[a] == -1) shortcuts++;
+            }
+            return shortcuts;
+        }
+};
+
+// arc weights of a hierarchy under one metric, several can be kept side by side
+class CustomizedMetric {
+    public:
+        ContractionHierarchy* hierarchy;
+        vector<float> roadWeight; // the metric as given, to tell roads from shortcuts while unpacking
+        vector<float> weight;     // customized weight of every arc
+
+        // O(triangles), the arcs are grouped by lower endpoint so all lower triangles are final when an arc is reached
+        CustomizedMetric(ContractionHierarchy& hierarchy, const vector<float>& roadWeights) {
+            TRACE_SPAN("customize hierarchy");
+            this->hierarchy = &hierarchy;
+            roadWeight = roadWeights;
+            weight.assign(hierarchy.arcCount(), numeric_limits<float>::infinity());
+
+            for (int a = 0; a < hierarchy.arcCount(); a++) {
+                if (hierarchy.arcRoad[a] != -1) {
+                    weight[a] = roadWeights[hierarchy.arcRoad[a]];
+                }
+                for (int t = hierarchy.firstTriangle[a]; t < hierarchy.firstTriangle[a + 1]; t++) {
+                    float viaTriangle = weight[hierarchy.triangles[t].first] + weight[hierarchy.triangles[t].second];
+                    if (viaTriangle < weight[a]) {
+                        weight[a] = viaTriangle;
+                    }
+                }
+            }
+        }
+};
+
+// point to point queries on a customized metric, walks the elimination tree upwards from both ends so no heap is needed.
+// keeps scratch arrays, use one per thread
+class HierarchyQuery {
+    private:
+        CustomizedMetric* metric;
+        vector<float> forward, backward;     // tentative distances by rank
+        vector<int> forwardArc, backwardArc; // arc used to reach each rank
+
+        void climb(int from, vector<float>& distance, vector<int>& parentArc) {
+            ContractionHierarchy* h = metric->hierarchy;
+            for (int v = from; v != -1; v = h->eliminationParent[v]) {
+                if (distance[v] == numeric_limits<float>::infinity()) continue;
+                for (int a = h->firstArc[v]; a < h->firstArc[v + 1]; a++) {
+                    float newDistance = distance[v] + metric->weight[a];
+                    if (newDistance < distance[h->arcHead[a]]) {
+                        distance[h->arcHead[a]] = newDistance;
+                        parentArc[h->arcHead[a]] = a;
+                    }
+                }
+            }
+        }
+
+        void reset(int from, vector<float>& distance, vector<int>& parentArc) {
+            for (int v = from; v != -1; v = metric->hierarchy->eliminationParent[v]) {
+                distance[v] = numeric_limits<float>::infinity();
+                parentArc[v] = -1;
+            }
+        }
+
+        // appends the vertices after fromRank up to toRank along the arc
+        void unpack(int fromRank, int toRank, int arc, vector<int>& path) {
+            ContractionHierarchy* h = metric->hierarchy;
+            if (h->arcRoad[arc] != -1 && metric->weight[arc] == metric->roadWeight[h->arcRoad[arc]]) {
+                path.push_back(h->vertexOfRank[toRank]);
+                return;
+            }
+            for (int t = h->firstTriangle[arc]; t < h->firstTriangle[arc + 1]; t++) {
+                int lowerArc = h->triangles[t].first;  // v -> u, u is the tail of arc
+                int upperArc = h->triangles[t].second; // v -> w, w is the head of arc
+                if (metric->weight[lowerArc] + metric->weight[upperArc] != metric->weight[arc]) continue;
+
+                int v = h->arcTail[lowerArc];
+                bool upwards = fromRank == h->arcTail[arc];
+                unpack(fromRank, v, upwards ? lowerArc : upperArc, path);
+                unpack(v, toRank, upwards ? upperArc : lowerArc, path);
+                return;
+            }
+        }
+
+        int meet(int sourceRank, int targetRank, float& best) {
+            ContractionHierarchy* h = metric->hierarchy;
+            forward[sourceRank] = 0;
+            backward[targetRank] = 0;
+            climb(sourceRank, forward, forwardArc);
+            climb(targetRank, backward, backwardArc);
+
+            // the common ancestors of both ends are the only candidates for the top of the path
+            int top = -1;
+            best = numeric_limits<float>::infinity();
+            for (int v = targetRank; v != -1; v = h->eliminationParent[v]) {
+                if (forward[v] + backward[v] < best) {
+                    best = forward[v] + backward[v];
+                    top = v;
+                }
+            }
+            return top;
+        }
+
+    public:
+        HierarchyQuery(CustomizedMetric& metric) {
+            this->metric = &metric;
+            int n = metric.hierarchy->vertexCount;
+            forward.assign(n, numeric_limits<float>::infinity());
+            backward.assign(n, numeric_limits<float>::infinity());
+            forwardArc.assign(n, -1);
+            backwardArc.assign(n, -1);
+        }
+
+        // returns infinity if the cities are not connected
+        float getDistance(Vertex* from, Vertex* to) { // O(height of the elimination tree * degree)
+            TRACE_SPAN("hierarchy distance");
+            ContractionHierarchy* h = metric->hierarchy;
+            float best;
+            meet(h->rank[from->id], h->rank[to->id], best);
+            reset(h->rank[from->id], forward, forwardArc);
+            reset(h->rank[to->id], backward, backwardArc);
+            return best == numeric_limits<float>::infinity() ? infinity : best;
+        }
+
+        // cities from source to destination, empty if they are not connected
+        vector<Vertex*> getShortestPath(Vertex* from, Vertex* to) {
+            TRACE_SPAN("hierarchy path unpack");
+            ContractionHierarchy* h = metric->hierarchy;
+            int sourceRank = h->rank[from->id];
+            int targetRank = h->rank[to->id];
+            float best;
+            int top = meet(sourceRank, targetRank, best);
+
+            vector<Vertex*> path;
+            if (top != -1) {
+                // arcs from the source up to the top, then from the top down to the target
+                vector<int> upArcs, downArcs;
+                for (int v = top; v != sourceRank; v = h->arcTail[forwardArc[v]]) upArcs.push_back(forwardArc[v]);
+                for (int v = top; v != targetRank; v = h->arcTail[backwardArc[v]]) downArcs.push_back(backwardArc[v]);
+
+                vector<int> vertices(1, from->id);
+                for (int i = upArcs.size() - 1; i >= 0; i--) {
+                    unpack(h->arcTail[upArcs[i]], h->arcHead[upArcs[i]], upArcs[i], vertices);
+                }
+                for (int i = 0; i < downArcs.size(); i++) {
+                    unpack(h->arcHead[downArcs[i]], h->arcTail[downArcs[i]], downArcs[i], vertices);
+                }
+                for (int i = 0; i < vertices.size(); i++) {
+                    path.push_back(h->graph->getVertex(vertices[i]));
+                }
+            }
+            reset(sourceRank, forward, forwardArc);
+            reset(targetRank, backward, backwardArc);
+            return path;
+        }
+};
+
+
+///////////////////////////////////////// Alternative Routes /////////////////////////////////////////
+
+class Route {
+    public:
+        vector<Vertex*> path;
+        vector<int> roads;
+        float weight;   // under the metric the route was searched with
+        float distance; // km
+        float toll;     // Rs.
+        float fares[vehicle_tiers]; // Rs. per vehicle tier, distance based fare plus tolls
+
+        Route() {
+            weight = 0;
+            distance = 0;
+            toll = 0;
+            for (int i = 0; i < vehicle_tiers; i++) fares[i] = 0;
+        }
+
+        Route(Graph& graph, const vector<int>& vertices, const vector<int>& roads, const vector<float>& weights) {
+            this->roads = roads;
+            weight = 0;
+            distance = 0;
+            toll = 0;
+            for (int i = 0; i < vertices.size(); i++) {
+                path.push_back(graph.getVertex(vertices[i]));
+            }
+            for (int i = 0; i < roads.size(); i++) {
+                Road* road = graph.getRoad(roads[i]);
+                weight += weights[roads[i]];
+                distance += road->distance;
+                toll += road->toll;
+            }
+            for (int i = 0; i < vehicle_tiers; i++) {
+                fares[i] = distance * vehicle_tier_rates[i] + toll;
+            }
+        }
+};
+
+// ranked alternatives between two cities:
+//  - kShortestPaths: Yen's k shortest loopless paths. The shortest path tree towards the destination is built once and
+//    reused by every spur search, as an exact A* potential, to take the spur path directly when none of its roads are
+//    banned, and to skip spur cities that cannot beat the candidates already found
+//  - plausibleAlternatives: via-city routes (source -> via -> destination) from one forward and one backward tree,
+//    kept only if they are at most maxStretch longer than the shortest route, share at most maxOverlap of its length
+//    with the routes already picked and are locally optimal around the via city
+class AlternativeRoutes {
+    private:
+        Graph* graph;
+        vector<float> weights;
+        ShortestPathTree toTarget;
+
+        // search scratch, reset through the touched list
+        vector<float> distance;
+        vector<int> parent, parentRoad;
+        vector<int> touched;
+        vector<bool> bannedVertex, bannedRoad;
+
+        void resetSearch() {
+            for (int i = 0; i < touched.size(); i++) {
+                distance[touched[i]] = infinity;
+                parent[touched[i]] = -1;
+                parentRoad[touched[i]] = -1;
+            }
+            touched.clear();
+        }
+
+        // A* from one city to another avoiding banned cities and roads, with the distances towards the destination
+        // as potential when usePotential is set. returns the weight, infinity if there is no such path or it exceeds the bound
+        float search(int from, int to, bool usePotential, float bound) { // O(E*logV)
+            DistanceHeap heap;
+            distance[from] = 0;
+            touched.push_back(from);
+            heap.insert(from, usePotential ? toTarget.distance[from] : 0);
+
+            while (!heap.isEmpty()) {
+                pair<float, int> entry = heap.extractMin();
+                int current = entry.second;
+                float key = distance[current] + (usePotential ? toTarget.distance[current] : 0);
+                if (entry.first > key) continue; // stale entry
+                if (key >= bound) break;
+                if (current == to) return distance[to];
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || bannedRoad[road->id] || bannedVertex[adjacent]) continue;
+                    if (usePotential && !toTarget.reaches(adjacent)) continue;
+
+                    float newDistance = distance[current] + weights[road->id];
+                    if (newDistance < distance[adjacent]) {
+                        if (distance[adjacent] == infinity) touched.push_back(adjacent);
+                        distance[adjacent] = newDistance;
+                        parent[adjacent] = current;
+                        parentRoad[adjacent] = road->id;
+                        heap.insert(adjacent, newDistance + (usePotential ? toTarget.distance[adjacent] : 0));
+                    }
+                }
+            }
+            return infinity;
+        }
+
+        // follows the tree towards the destination, fails if it runs into a banned city or road
+        bool followTree(int from, vector<int>& vertices, vector<int>& roads) {
+            for (int v = from; v != toTarget.source; v = toTarget.parent[v]) {
+                int next = toTarget.parent[v];
+                if (bannedRoad[toTarget.parentRoad[v]] || bannedVertex[next]) {
+                    return false;
+                }
+                vertices.push_back(next);
+                roads.push_back(toTarget.parentRoad[v]);
+            }
+            return true;
+        }
+
+        Route shortestRoute(int from) {
+            vector<int> vertices(1, from), roads;
+            followTree(from, vertices, roads);
+            return Route(*graph, vertices, roads, weights);
+        }
+
+        bool isSimple(const vector<int>& vertices) {
+            bool simple = true;
+            for (int i = 0; i < vertices.size(); i++) {
+                if (bannedVertex[vertices[i]]) simple = false;
+                bannedVertex[vertices[i]] = true;
+            }
+            for (int i = 0; i < vertices.size(); i++) {
+                bannedVertex[vertices[i]] = false;
+            }
+            return simple;
+        }
+
+    public:
+        AlternativeRoutes(Graph& graph, const vector<float>& weights) {
+            this->graph = &graph;
+            this->weights = weights;
+            int n = graph.vertexCount();
+            distance.assign(n, infinity);
+            parent.assign(n, -1);
+            parentRoad.assign(n, -1);
+            bannedVertex.assign(n, false);
+            bannedRoad.assign(graph.roadCount(), false);
+        }
+
+        AlternativeRoutes(Graph& graph) : AlternativeRoutes(graph, Metrics::distance(graph)) {}
+
+        // up to k loopless routes in increasing weight, fewer if the cities do not have that many
+        vector<Route> kShortestPaths(Vertex* from, Vertex* to, int k) { // O(k*V*E*logV)
+            vector<Route> found;
+            if (toTarget.source != to->id) {
+                toTarget = Dijkstra::getShortestPathTree(*graph, to, weights);
+            }
+            if (!toTarget.reaches(from->id) || k <= 0) {
+                return found;
+            }
+
+            found.push_back(shortestRoute(from->id));
+            vector<Route> candidates;
+            set<vector<int>> seen;
+            seen.insert(found[0].roads);
+
+            while (found.size() < k) {
+                Route& previous = found.back();
+                vector<int> previousVertices;
+                for (int i = 0; i < previous.path.size(); i++) previousVertices.push_back(previous.path[i]->id);
+
+                float rootWeight = 0;
+                for (int i = 0; i + 1 < previousVertices.size(); i++) {
+                    int spur = previousVertices[i];
+
+                    // a spur can only help if it can beat the candidate that would otherwise be taken last
+                    int needed = k - found.size();
+                    if (candidates.size() >= needed) {
+                        vector<float> candidateWeights;
+                        for (int c = 0; c < candidates.size(); c++) candidateWeights.push_back(candidates[c].weight);
+                        nth_element(candidateWeights.begin(), candidateWeights.begin() + needed - 1, candidateWeights.end());
+                        if (rootWeight + toTarget.distance[spur] >= candidateWeights[needed - 1]) {
+                            rootWeight += weights[previous.roads[i]];
+                            continue;
+                        }
+                    }
+
+                    // ban the next road of every found route sharing this root, and the root itself
+                    vector<int> banned;
+                    for (int p = 0; p < found.size(); p++) {
+                        if (found[p].path.size() <= i + 1) continue;
+                        bool sameRoot = true;
+                        for (int j = 0; j <= i && sameRoot; j++) sameRoot = found[p].path[j]->id == previousVertices[j];
+                        if (sameRoot) {
+                            bannedRoad[found[p].roads[i]] = true;
+                            banned.push_back(found[p].roads[i]);
+                        }
+                    }
+                    for (int j = 0; j < i; j++) bannedVertex[previousVertices[j]] = true;
+
+                    vector<int> vertices(previousVertices.begin(), previousVertices.begin() + i + 1);
+                    vector<int> roads(previous.roads.begin(), previous.roads.begin() + i);
+                    bool foundSpur = followTree(spur, vertices, roads);
+                    if (!foundSpur) {
+                        vertices.resize(i + 1);
+                        roads.resize(i);
+                        if (search(spur, to->id, true, infinity) < infinity) {
+                            vector<int> spurVertices, spurRoads;
+                            for (int v = to->id; v != spur; v = parent[v]) {
+                                spurVertices.push_back(v);
+                                spurRoads.push_back(parentRoad[v]);
+                            }
+                            vertices.insert(vertices.end(), spurVertices.rbegin(), spurVertices.rend());
+                            roads.insert(roads.end(), spurRoads.rbegin(), spurRoads.rend());
+                            foundSpur = true;
+                        }
+                        resetSearch();
+                    }
+
+                    for (int j = 0; j < banned.size(); j++) bannedRoad[banned[j]] = false;
+                    for (int j = 0; j < i; j++) bannedVertex[previousVertices[j]] = false;
+
+                    if (foundSpur && seen.insert(roads).second) {
+                        candidates.push_back(Route(*graph, vertices, roads, weights));
+                    }
+                    rootWeight += weights[previous.roads[i]];
+                }
+
+                if (candidates.empty()) break;
+                int best = 0;
+                for (int c = 1; c < candidates.size(); c++) {
+                    if (candidates[c].weight < candidates[best].weight) best = c;
+                }
+                found.push_back(candidates[best]);
+                candidates.erase(candidates.begin() + best);
+            }
+            return found;
+        }
+
+        // the shortest route followed by up to k - 1 plausible alternatives, in increasing weight
+        vector<Route> plausibleAlternatives(Vertex* from, Vertex* to, int k, float maxStretch = 0.25, float maxOverlap = 0.6, float localOptimality = 0.25) { // O(E*logV + V*L) for routes of L roads
+            vector<Route> picked;
+            if (toTarget.source != to->id) {
+                toTarget = Dijkstra::getShortestPathTree(*graph, to, weights);
+            }
+            if (!toTarget.reaches(from->id) || k <= 0) {
+                return picked;
+            }
+            ShortestPathTree fromSource = Dijkstra::getShortestPathTree(*graph, from, weights);
+            float shortest = toTarget.distance[from->id];
+
+            picked.push_back(shortestRoute(from->id));
+            vector<bool> usedRoad(graph->roadCount(), false);
+            for (int i = 0; i < picked[0].roads.size(); i++) usedRoad[picked[0].roads[i]] = true;
+
+            vector<pair<float, int>> vias;
+            for (int v = 0; v < graph->vertexCount(); v++) {
+                float via = fromSource.distance[v] + toTarget.distance[v];
+                if (fromSource.reaches(v) && toTarget.reaches(v) && via <= (1 + maxStretch) * shortest) {
+                    vias.push_back(make_pair(via, v));
+                }
+            }
+            sort(vias.begin(), vias.end());
+
+            set<vector<int>> seen;
+            seen.insert(picked[0].roads);
+            for (int c = 0; c < vias.size() && picked.size() < k; c++) {
+                int via = vias[c].second;
+                vector<int> vertices, roads;
+                for (int v = via; v != from->id; v = fromSource.parent[v]) {
+                    vertices.push_back(v);
+                    roads.push_back(fromSource.parentRoad[v]);
+                }
+                vertices.push_back(from->id);
+                reverse(vertices.begin(), vertices.end());
+                reverse(roads.begin(), roads.end());
+                followTree(via, vertices, roads);
+
+                if (!seen.insert(roads).second || !isSimple(vertices)) continue;
+
+                float overlap = 0;
+                for (int i = 0; i < roads.size(); i++) {
+                    if (usedRoad[roads[i]]) overlap += weights[roads[i]];
+                }
+                if (overlap > maxOverlap * shortest) continue;
+
+                // local optimality: the stretch of localOptimality * shortest on both sides of the via city must be a shortest path
+                int viaIndex = find(vertices.begin(), vertices.end(), via) - vertices.begin();
+                int first = viaIndex, last = viaIndex;
+                float around = 0, window = localOptimality * shortest;
+                for (float back = 0; first > 0 && back < window; first--) back += weights[roads[first - 1]];
+                for (float ahead = 0; last + 1 < vertices.size() && ahead < window; last++) ahead += weights[roads[last]];
+                for (int i = first; i < last; i++) around += weights[roads[i]];
+                float direct = search(vertices[first], vertices[last], false, around + 1e-3f);
+                resetSearch();
+                if (direct < around - 1e-3f) continue;
+
+                picked.push_back(Route(*graph, vertices, roads, weights));
+                for (int i = 0; i < roads.size(); i++) usedRoad[roads[i]] = true;
+            }
+            return picked;
+        }
+};
+
+
+///////////////////////////////////////// Isochrones /////////////////////////////////////////
+
+// cities reachable from an origin within a budget, in increasing distance (the origin first)
+class Isochrone {
+    public:
+        Vertex* origin;
+        float budget;
+        vector<pair<Vertex*, float>> reachable;
+
+        Isochrone() {
+            origin = NULL;
+            budget = 0;
+        }
+};
+
+// dijkstra that stops once the budget is exceeded, so only the cities inside the isochrone are settled.
+// keeps scratch arrays between runs and resets only what it touched, use one per thread
+class IsochroneSearch {
+    private:
+        Graph* graph;
+        vector<float> weights;
+        vector<float> distance;
+        vector<bool> visited;
+        vector<int> touched;
+
+    public:
+        IsochroneSearch(Graph& graph, const vector<float>& weights) {
+            this->graph = &graph;
+            this->weights = weights;
+            distance.assign(graph.vertexCount(), infinity);
+            visited.assign(graph.vertexCount(), false);
+        }
+
+        Isochrone within(Vertex* origin, float budget) { // O(E'*logV') for the V' cities and E' roads inside the budget
+            TRACE_SPAN("isochrone");
+            Isochrone isochrone;
+            isochrone.origin = origin;
+            isochrone.budget = budget;
+
+            DistanceHeap unsettledVertices;
+            distance[origin->id] = 0;
+            touched.push_back(origin->id);
+            unsettledVertices.insert(origin->id, 0);
+
+            while (!unsettledVertices.isEmpty()) {
+                pair<float, int> entry = unsettledVertices.extractMin();
+                int current = entry.second;
+                if (entry.first > budget) break; // everything left is further away
+                if (visited[current]) continue;
+                visited[current] = true;
+                isochrone.reachable.push_back(make_pair(graph->getVertex(current), distance[current]));
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || visited[adjacent]) continue;
+
+                    float newDistance = distance[current] + weights[road->id];
+                    if (newDistance <= budget && newDistance < distance[adjacent]) {
+                        if (distance[adjacent] == infinity) touched.push_back(adjacent);
+                        distance[adjacent] = newDistance;
+                        unsettledVertices.insert(adjacent, newDistance);
+                    }
+                }
+            }
+
+            for (int i = 0; i < touched.size(); i++) {
+                distance[touched[i]] = infinity;
+                visited[touched[i]] = false;
+            }
+            touched.clear();
+            return isochrone;
+        }
+};
+
+class Isochrones {
+    public:
+        static Isochrone withinDistance(Graph& graph, Vertex* origin, float km) {
+            IsochroneSearch search(graph, Metrics::distance(graph));
+            return search.within(origin, km);
+        }
+
+        // budget in Rs. for the vehicle's cost per km, tolls included
+        static Isochrone withinFare(Graph& graph, Vertex* origin, float rupees, int cost_per_KM) {
+            IsochroneSearch search(graph, Metrics::fare(graph, cost_per_KM));
+            return search.within(origin, rupees);
+        }
+
+        // one isochrone per origin, in the same order, computed on up to threads worker threads that take origins as they go
+        static vector<Isochrone> batch(Graph& graph, const vector<Vertex*>& origins, float budget, const vector<float>& weights, int threads = thread::hardware_concurrency()) {
+            vector<Isochrone> isochrones(origins.size());
+            atomic<int> next(0);
+            threads = max(1, min(threads, (int)origins.size()));
+
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.push_back(thread([&]() {
+                    IsochroneSearch search(graph, weights);
+                    for (int i = next++; i < origins.size(); i = next++) {
+                        isochrones[i] = search.within(origins[i], budget);
+                    }
+                }));
+            }
+            for (int t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            return isochrones;
+        }
+};
+
+
+///////////////////////////////////////// Multi-Stop Trips /////////////////////////////////////////
+
+class Trip {
+    public:
+        vector<Vertex*> stops; // in visiting order, the first stop again at the end of a round trip
+        Route route;           // every city and road driven, legs joined at the stops
+
+        bool found() {
+            return !route.path.empty();
+        }
+};
+
+// visiting order for multi-drop runs: the first stop is where the trip starts, the rest are reordered to minimise
+// the total weight. the stop x stop matrix comes from one shortest path tree per stop, searched in parallel, and
+// the order from Held-Karp (exact, O(2^n * n^2)) for up to exactLimit reorderable stops, otherwise from a nearest
+// neighbour tour improved by 2-opt and Or-opt moves until neither helps. roads are undirected so the matrix is
+// symmetric, which lets 2-opt reverse a stretch of the trip for the price of its two end legs
+class TripPlanner {
+    private:
+        Graph* graph;
+        vector<float> weights;
+        int threads;
+
+        // legs of a trip as matrix positions, with end as the last entry: -1 (nowhere, free end), the first stop
+        // (round trip) or the fixed last stop. only positions 1 .. size-2 move
+        static float leg(const vector<vector<float>>& matrix, int from, int to) {
+            return from == -1 || to == -1 ? 0 : matrix[from][to];
+        }
+
+        static float cost(const vector<vector<float>>& matrix, const vector<int>& order) {
+            float total = 0;
+            for (int i = 0; i + 1 < order.size(); i++) total += leg(matrix, order[i], order[i + 1]);
+            return total;
+        }
+
+        // Held-Karp over the movable stops, best[mask][j] = cheapest start -> (stops of mask) ending at movable stop j
+        static vector<int> solveExact(const vector<vector<float>>& matrix, const vector<int>& movable, int end) { // O(2^m * m^2)
+            int m = movable.size();
+            vector<int> order(1, 0);
+            if (m == 0) {
+                order.push_back(end);
+                return order;
+            }
+            int full = (1 << m) - 1;
+            vector<vector<float>> best(full + 1, vector<float>(m, numeric_limits<float>::infinity()));
+            vector<vector<int>> previous(full + 1, vector<int>(m, -1));
+            for (int j = 0; j < m; j++) best[1 << j][j] = matrix[0][movable[j]];
+
+            for (int mask = 1; mask <= full; mask++) {
+                for (int j = 0; j < m; j++) {
+                    if (!(mask & (1 << j)) || best[mask][j] == numeric_limits<float>::infinity()) continue;
+                    for (int k = 0; k < m; k++) {
+                        if (mask & (1 << k)) continue;
+                        float candidate = best[mask][j] + matrix[movable[j]][movable[k]];
+                        if (candidate < best[mask | (1 << k)][k]) {
+                            best[mask | (1 << k)][k] = candidate;
+                            previous[mask | (1 << k)][k] = j;
+                        }
+                    }
+                }
+            }
+
+            int last = 0;
+            for (int j = 1; j < m; j++) {
+                if (best[full][j] + leg(matrix, movable[j], end) < best[full][last] + leg(matrix, movable[last], end)) last = j;
+            }
+            vector<int> middle;
+            for (int mask = full, j = last; j != -1; ) {
+                middle.push_back(movable[j]);
+                int before = previous[mask][j];
+                mask &= ~(1 << j);
+                j = before;
+            }
+            reverse(middle.begin(), middle.end());
+            order.insert(order.end(), middle.begin(), middle.end());
+            order.push_back(end);
+            return order;
+        }
+
+        static vector<int> nearestNeighbour(const vector<vector<float>>& matrix, const vector<int>& movable, int end) { // O(m^2)
+            vector<int> order(1, 0);
+            vector<bool> used(movable.size(), false);
+            for (int step = 0; step < movable.size(); step++) {
+                int next = -1;
+                for (int j = 0; j < movable.size(); j++) {
+                    if (!used[j] && (next == -1 || matrix[order.back()][movable[j]] < matrix[order.back()][movable[next]])) next = j;
+                }
+                used[next] = true;
+                order.push_back(movable[next]);
+            }
+            order.push_back(end);
+            return order;
+        }
+
+        // first improvement 2-opt (reverse order[i..j]) and Or-opt (move a run of up to 3 stops elsewhere), repeated
+        // until a whole pass finds nothing. O(n^2) per pass
+        static void improve(const vector<vector<float>>& matrix, vector<int>& order) {
+            const float epsilon = 1e-4; // ignore float noise so equal tours cannot cycle
+            int last = order.size() - 2; // last movable position
+            bool improved = true;
+            while (improved) {
+                improved = false;
+
+                for (int i = 1; i < last; i++) {
+                    for (int j = i + 1; j <= last; j++) {
+                        float delta = leg(matrix, order[i - 1], order[j]) + leg(matrix, order[i], order[j + 1])
+                            - leg(matrix, order[i - 1], order[i]) - leg(matrix, order[j], order[j + 1]);
+                        if (delta < -epsilon) {
+                            reverse(order.begin() + i, order.begin() + j + 1);
+                            improved = true;
+                        }
+                    }
+                }
+
+                for (int length = 1; length <= 3; length++) {
+                    for (int i = 1; i + length - 1 <= last; i++) {
+                        int head = order[i], tail = order[i + length - 1];
+                        float removed = leg(matrix, order[i - 1], head) + leg(matrix, tail, order[i + length])
+                            - leg(matrix, order[i - 1], order[i + length]);
+                        for (int p = 0; p <= last; p++) { // insert between order[p] and order[p + 1]
+                            if (p >= i - 1 && p <= i + length - 1) continue;
+                            float delta = leg(matrix, order[p], head) + leg(matrix, tail, order[p + 1])
+                                - leg(matrix, order[p], order[p + 1]) - removed;
+                            if (delta < -epsilon) {
+                                if (p < i) rotate(order.begin() + p + 1, order.begin() + i, order.begin() + i + length);
+                                else rotate(order.begin() + i, order.begin() + i + length, order.begin() + p + 1);
+                                improved = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+    public:
+        static const int exactLimit = 12; // reorderable stops solved exactly, 2^12 * 12 * 12 steps
+
+        TripPlanner(Graph& graph, const vector<float>& weights, int threads = thread::hardware_concurrency()) {
+            this->graph = &graph;
+            this->weights = weights;
+            this->threads = max(1, threads);
+        }
+
+        // one shortest path tree per stop, computed on up to threads worker threads that take stops as they go
+        vector<ShortestPathTree> searchFrom(const vector<Vertex*>& stops) {
+            vector<ShortestPathTree> trees(stops.size());
+            atomic<int> next(0);
+            int workerCount = max(1, min(threads, (int)stops.size()));
+
+            vector<thread> workers;
+            for (int t = 0; t < workerCount; t++) {
+                workers.push_back(thread([&]() {
+                    for (int i = next++; i < stops.size(); i = next++) {
+                        trees[i] = Dijkstra::getShortestPathTree(*graph, stops[i], weights);
+                    }
+                }));
+            }
+            for (int t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            return trees;
+        }
+
+        // matrix[i][j] = weight of the shortest route from stops[i] to stops[j], infinity if there is none
+        vector<vector<float>> distanceMatrix(const vector<Vertex*>& stops) {
+            vector<ShortestPathTree> trees = searchFrom(stops);
+            vector<vector<float>> matrix(stops.size(), vector<float>(stops.size()));
+            for (int i = 0; i < stops.size(); i++) {
+                for (int j = 0; j < stops.size(); j++) matrix[i][j] = trees[i].distance[stops[j]->id];
+            }
+            return matrix;
+        }
+
+        // starts at stops[0], visits every other stop once and then ends wherever is cheapest, back at stops[0]
+        // (roundTrip) or at the last given stop (keepLastStop). an empty trip if some stop cannot be reached
+        Trip plan(const vector<Vertex*>& stops, bool roundTrip = false, bool keepLastStop = false) {
+            TRACE_SPAN("plan trip");
+            Trip trip;
+            if (stops.empty()) {
+                return trip;
+            }
+            vector<ShortestPathTree> trees = searchFrom(stops);
+            int n = stops.size();
+            vector<vector<float>> matrix(n, vector<float>(n));
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    if (!trees[i].reaches(stops[j]->id)) {
+                        return trip;
+                    }
+                    matrix[i][j] = trees[i].distance[stops[j]->id];
+                }
+            }
+
+            int end = roundTrip ? 0 : (keepLastStop && n > 1 ? n - 1 : -1);
+            vector<int> movable;
+            for (int i = 1; i < n; i++) {
+                if (i != end) movable.push_back(i);
+            }
+            vector<int> order;
+            if (movable.size() <= exactLimit) {
+                order = solveExact(matrix, movable, end);
+            }
+            else {
+                order = nearestNeighbour(matrix, movable, end);
+                improve(matrix, order);
+            }
+            if (order.back() == -1) order.pop_back();
+
+            // stitch the legs, walking each one back through the tree of the stop it leaves from
+            vector<int> vertices(1, stops[0]->id), roads;
+            for (int i = 0; i + 1 < order.size(); i++) {
+                ShortestPathTree& tree = trees[order[i]];
+                vector<int> legVertices, legRoads;
+                for (int v = stops[order[i + 1]]->id; v != tree.source; v = tree.parent[v]) {
+                    legVertices.push_back(v);
+                    legRoads.push_back(tree.parentRoad[v]);
+                }
+                vertices.insert(vertices.end(), legVertices.rbegin(), legVertices.rend());
+                roads.insert(roads.end(), legRoads.rbegin(), legRoads.rend());
+            }
+            for (int i = 0; i < order.size(); i++) trip.stops.push_back(stops[order[i]]);
+            trip.route = Route(*graph, vertices, roads, weights);
+            return trip;
+        }
+};
+
+
+///////////////////////////////////////// Pareto Routes /////////////////////////////////////////
+
+// every route between two cities that no other route beats on distance, tolls and travel time at once, from one
+// multi-criteria label-setting search. a fare is distance * rate + tolls, so this set holds the cheapest route of
+// every vehicle tier as well as the shortest and the fastest, each route's fares are filled in per tier.
+// the labels of a city are kept mutually non-dominated and are checked against the destination's labels before
+// being stored. to keep the search fast on large maps a city keeps at most maxLabels labels and, with epsilon > 0,
+// a label within a factor (1 + epsilon) of an existing one on every criterion is dropped; both trade exactness for speed
+class ParetoRoutes {
+    private:
+        struct Label {
+            float distance; // km
+            float toll;     // Rs.
+            float time;     // minutes
+            int vertex;
+            int parent;     // label this one extends, -1 at the source
+            int road;       // road from the parent's city, -1 at the source
+            bool alive;     // false once dominated by a later label
+        };
+
+        Graph* graph;
+        int maxLabels;
+        float epsilon;
+
+        // search state, reset through the touched list
+        vector<Label> labels;
+        vector<vector<int>> bags; // alive labels per vertex id
+        vector<int> touched;
+
+        bool covers(const Label& a, const Label& b) {
+            float slack = 1 + epsilon;
+            return a.distance <= b.distance * slack && a.toll <= b.toll * slack && a.time <= b.time * slack;
+        }
+
+        static bool dominates(const Label& a, const Label& b) {
+            return a.distance <= b.distance && a.toll <= b.toll && a.time <= b.time;
+        }
+
+        // stores the label unless it is covered at its city or at the destination, evicting what it dominates
+        bool insert(const Label& label, int target) { // O(labels at both cities)
+            vector<int>& targetBag = bags[target];
+            for (int i = 0; i < targetBag.size(); i++) {
+                if (covers(labels[targetBag[i]], label)) return false;
+            }
+            vector<int>& bag = bags[label.vertex];
+            for (int i = 0; i < bag.size(); i++) {
+                if (covers(labels[bag[i]], label)) return false;
+            }
+            int kept = 0;
+            for (int i = 0; i < bag.size(); i++) {
+                if (dominates(label, labels[bag[i]])) labels[bag[i]].alive = false;
+                else bag[kept++] = bag[i];
+            }
+            bag.resize(kept);
+            if (bag.size() >= maxLabels) {
+                return false;
+            }
+            if (bag.empty()) touched.push_back(label.vertex);
+            bag.push_back(labels.size());
+            labels.push_back(label);
+            return true;
+        }
+
+    public:
+        ParetoRoutes(Graph& graph, int maxLabels = 64, float epsilon = 0) {
+            this->graph = &graph;
+            this->maxLabels = max(1, maxLabels);
+            this->epsilon = max(0.0f, epsilon);
+            bags.resize(graph.vertexCount());
+        }
+
+        // sorted by distance, the route's weight is its travel time in minutes. empty if the cities are not connected
+        vector<Route> between(Vertex* from, Vertex* to) { // O(L*logL + L*d*B) for L labels, degree d and B labels per city
+            TRACE_SPAN("pareto search");
+            if (bags.size() < graph->vertexCount()) bags.resize(graph->vertexCount());
+            labels.clear();
+            DistanceHeap heap; // labels by distance, dominated labels never come out before the labels dominating them
+            insert({ 0, 0, 0, from->id, -1, -1, true }, to->id);
+            heap.insert(0, 0);
+
+            while (!heap.isEmpty()) {
+                int current = heap.extractMin().second;
+                if (!labels[current].alive || labels[current].vertex == to->id) continue;
+                Label label = labels[current]; // copied, insert() may grow the label list
+                Vertex* city = graph->getVertex(label.vertex);
+                for (int i = 0; i < city->roads.size(); i++) {
+                    Road* road = city->roads[i];
+                    if (!road->open) continue;
+                    Label next = { label.distance + road->distance, label.toll + road->toll,
+                        label.time + road->distance / road->speed * 60, city->neighbors[i]->id, current, road->id, true };
+                    if (insert(next, to->id)) {
+                        heap.insert(labels.size() - 1, next.distance);
+                    }
+                }
+            }
+
+            vector<Route> routes;
+            vector<float> minutes = Metrics::travelTime(*graph);
+            vector<int> found = bags[to->id];
+            sort(found.begin(), found.end(), [&](int a, int b) { return labels[a].distance < labels[b].distance; });
+            for (int i = 0; i < found.size(); i++) {
+                vector<int> vertices, roads;
+                for (int l = found[i]; l != -1; l = labels[l].parent) {
+                    vertices.push_back(labels[l].vertex);
+                    if (labels[l].road != -1) roads.push_back(labels[l].road);
+                }
+                reverse(vertices.begin(), vertices.end());
+                reverse(roads.begin(), roads.end());
+                routes.push_back(Route(*graph, vertices, roads, minutes));
+            }
+
+            for (int i = 0; i < touched.size(); i++) bags[touched[i]].clear();
+            touched.clear();
+            return routes;
+        }
+
+        // index into routes of the cheapest one for a vehicle tier, -1 if there are none
+        static int cheapest(const vector<Route>& routes, int tier) {
+            int best = -1;
+            for (int i = 0; i < routes.size(); i++) {
+                if (best == -1 || routes[i].fares[tier] < routes[best].fares[tier]) best = i;
+            }
+            return best;
+        }
+};
+
+
+///////////////////////////////////////// Batch Queries /////////////////////////////////////////
+
+// many sources to one target, e.g. which of the vehicles is closest by road to a pickup. roads are undirected, so a
+// single search from the target reaches every source and stops as soon as the last one (or for closest(), the first
+// one) is settled instead of running one search per source. keeps scratch arrays, use one per thread
+class ManyToOne {
+    private:
+        Graph* graph;
+        vector<float> weights;
+        vector<float> distance;
+        vector<int> parent, parentRoad; // towards the target
+        vector<bool> settled;
+        vector<int> wanted;             // how many times each city appears among the sources
+        vector<int> touched;
+
+        void reset() {
+            for (int i = 0; i < touched.size(); i++) {
+                distance[touched[i]] = infinity;
+                parent[touched[i]] = -1;
+                parentRoad[touched[i]] = -1;
+                settled[touched[i]] = false;
+            }
+            touched.clear();
+        }
+
+        // settles cities from the target outwards until stopAfter of the sources are settled. O(E'*logV') for the
+        // V' cities and E' roads closer to the target than the last source settled
+        void search(const vector<Vertex*>& sources, Vertex* target, int stopAfter) {
+            reset();
+            for (int i = 0; i < sources.size(); i++) wanted[sources[i]->id]++;
+
+            DistanceHeap unsettledVertices;
+            distance[target->id] = 0;
+            touched.push_back(target->id);
+            unsettledVertices.insert(target->id, 0);
+            int found = 0;
+
+            while (!unsettledVertices.isEmpty() && found < stopAfter) {
+                int current = unsettledVertices.extractMin().second;
+                if (settled[current]) continue;
+                settled[current] = true;
+                found += wanted[current];
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || settled[adjacent]) continue;
+
+                    float newDistance = distance[current] + weights[road->id];
+                    if (newDistance < distance[adjacent]) {
+                        if (distance[adjacent] == infinity) touched.push_back(adjacent);
+                        distance[adjacent] = newDistance;
+                        parent[adjacent] = current;
+                        parentRoad[adjacent] = road->id;
+                        unsettledVertices.insert(adjacent, newDistance);
+                    }
+                }
+            }
+
+            for (int i = 0; i < sources.size(); i++) wanted[sources[i]->id] = 0;
+        }
+
+    public:
+        ManyToOne(Graph& graph, const vector<float>& weights) {
+            this->graph = &graph;
+            this->weights = weights;
+            distance.assign(graph.vertexCount(), infinity);
+            parent.assign(graph.vertexCount(), -1);
+            parentRoad.assign(graph.vertexCount(), -1);
+            settled.assign(graph.vertexCount(), false);
+            wanted.assign(graph.vertexCount(), 0);
+        }
+
+        // distance from each source to the target, in the order given, infinity for sources that cannot reach it
+        vector<float> distancesTo(const vector<Vertex*>& sources, Vertex* target) {
+            TRACE_SPAN("many to one");
+            search(sources, target, sources.size());
+            vector<float> result(sources.size());
+            for (int i = 0; i < sources.size(); i++) {
+                result[i] = settled[sources[i]->id] ? distance[sources[i]->id] : infinity;
+            }
+            return result;
+        }
+
+        // index of the source closest to the target, -1 if none can reach it
+        int closest(const vector<Vertex*>& sources, Vertex* target) {
+            TRACE_SPAN("closest source");
+            search(sources, target, 1);
+            int best = -1;
+            for (int i = 0; i < sources.size(); i++) {
+                if (settled[sources[i]->id] && (best == -1 || distance[sources[i]->id] < distance[sources[best]->id])) best = i;
+            }
+            return best;
+        }
+
+        // cities from a source to the target of the last search, empty if that search did not settle the source
+        vector<Vertex*> pathFrom(Vertex* source) { // O(V)
+            vector<Vertex*> path;
+            if (!settled[source->id]) {
+                return path;
+            }
+            for (int v = source->id; v != -1; v = parent[v]) {
+                path.push_back(graph->getVertex(v));
+            }
+            return path;
+        }
+};
+
+// source x target distance tables on a customized hierarchy. every target climbs the elimination tree once and leaves
+// its distance to each ancestor in that ancestor's bucket, then every source climbs once and scans the buckets it
+// passes: the shortest path between two cities always tops out at a common ancestor, so the best bucket entry is
+// the distance. O((S+T) * climb + bucket scans) instead of S*T point queries; sources are split over threads
+class ManyToMany {
+    private:
+        CustomizedMetric* metric;
+
+        // distances from the rank to its ancestors, appended to reached as (rank, distance); scratch is left all infinity
+        void climb(int from, vector<float>& distance, vector<pair<int, float>>& reached) {
+            ContractionHierarchy* h = metric->hierarchy;
+            distance[from] = 0;
+            for (int v = from; v != -1; v = h->eliminationParent[v]) {
+                if (distance[v] == numeric_limits<float>::infinity()) continue;
+                reached.push_back(make_pair(v, distance[v]));
+                for (int a = h->firstArc[v]; a < h->firstArc[v + 1]; a++) {
+                    float newDistance = distance[v] + metric->weight[a];
+                    if (newDistance < distance[h->arcHead[a]]) distance[h->arcHead[a]] = newDistance;
+                }
+            }
+            for (int v = from; v != -1; v = h->eliminationParent[v]) distance[v] = numeric_limits<float>::infinity();
+        }
+
+    public:
+        ManyToMany(CustomizedMetric& metric) {
+            this->metric = &metric;
+        }
+
+        // table[i][j] = distance from sources[i] to targets[j], infinity if they are not connected
+        vector<vector<float>> distances(const vector<Vertex*>& sources, const vector<Vertex*>& targets, int threads = thread::hardware_concurrency()) {
+            TRACE_SPAN("many to many");
+            ContractionHierarchy* h = metric->hierarchy;
+            int n = h->vertexCount;
+
+            // buckets by rank, as one array: entries of rank r are firstEntry[r] .. firstEntry[r + 1] - 1
+            vector<float> scratch(n, numeric_limits<float>::infinity());
+            vector<int> firstEntry(n + 1, 0);
+            vector<pair<int, float>> entries; // (target index, distance)
+            {
+                vector<vector<pair<int, float>>> reached(targets.size());
+                for (int j = 0; j < targets.size(); j++) {
+                    climb(h->rank[targets[j]->id], scratch, reached[j]);
+                    for (int k = 0; k < reached[j].size(); k++) firstEntry[reached[j][k].first + 1]++;
+                }
+                for (int r = 0; r < n; r++) firstEntry[r + 1] += firstEntry[r];
+                entries.resize(firstEntry[n]);
+                vector<int> fill(firstEntry.begin(), firstEntry.end() - 1);
+                for (int j = 0; j < targets.size(); j++) {
+                    for (int k = 0; k < reached[j].size(); k++) {
+                        entries[fill[reached[j][k].first]++] = make_pair(j, reached[j][k].second);
+                    }
+                }
+            }
+
+            vector<vector<float>> table(sources.size(), vector<float>(targets.size(), numeric_limits<float>::infinity()));
+            atomic<int> next(0);
+            threads = max(1, min(threads, (int)sources.size()));
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.push_back(thread([&]() {
+                    vector<float> distance(n, numeric_limits<float>::infinity());
+                    vector<pair<int, float>> reached;
+                    for (int i = next++; i < sources.size(); i = next++) {
+                        reached.clear();
+                        climb(h->rank[sources[i]->id], distance, reached);
+                        vector<float>& row = table[i];
+                        for (int k = 0; k < reached.size(); k++) {
+                            int v = reached[k].first;
+                            for (int e = firstEntry[v]; e < firstEntry[v + 1]; e++) {
+                                float through = reached[k].second + entries[e].second;
+                                if (through < row[entries[e].first]) row[entries[e].first] = through;
+                            }
+                        }
+                        for (int j = 0; j < row.size(); j++) {
+                            if (row[j] == numeric_limits<float>::infinity()) row[j] = infinity;
+                        }
+                    }
+                }));
+            }
+            for (int t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            return table;
+        }
+};
+
+
+///////////////////////////////////////// Multi-Level Overlay /////////////////////////////////////////
+
+// CRP style overlay: for every cell of every level, the shortest distances inside the cell between its boundary cities
+// (cities with a road leaving the cell). level 1 cliques come from searches on the roads of the cell, higher levels
+// from searches on the level below (its cliques plus the roads between its cells). the partition is metric
+// independent, the cliques are recomputed by customize() whenever the weights change
+class OverlayGraph {
+    private:
+        // search scratch indexed by vertex id, reset through the touched list
+        vector<float> distance;
+        vector<int> touched;
+
+        void resetSearch() {
+            for (int i = 0; i < touched.size(); i++) distance[touched[i]] = infinity;
+            touched.clear();
+        }
+
+        // dijkstra from the source that never leaves its cell on the level, over the roads on level 1
+        // and over the overlay of the level below otherwise
+        void searchInCell(int level, int source) {
+            DistanceHeap heap;
+            int cell = partition->cellOf(level, source);
+            distance[source] = 0;
+            touched.push_back(source);
+            heap.insert(source, 0);
+
+            while (!heap.isEmpty()) {
+                pair<float, int> entry = heap.extractMin();
+                int current = entry.second;
+                if (entry.first > distance[current]) continue; // stale entry
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || partition->cellOf(level, adjacent) != cell) continue;
+                    if (level > 1 && partition->cellOf(level - 1, adjacent) == partition->cellOf(level - 1, current)) continue; // covered by the clique
+                    relax(heap, adjacent, distance[current] + weights[road->id]);
+                }
+                if (level > 1) {
+                    int below = level - 1;
+                    int subcell = partition->cellOf(below, current);
+                    int from = boundaryIndex[below - 1][current];
+                    vector<int>& ends = boundary[below - 1][subcell];
+                    for (int j = 0; j < ends.size(); j++) {
+                        relax(heap, ends[j], distance[current] + clique(below, subcell, from, j));
+                    }
+                }
+            }
+        }
+
+        void relax(DistanceHeap& heap, int vertex, float newDistance) {
+            if (newDistance < distance[vertex]) {
+                if (distance[vertex] == infinity) touched.push_back(vertex);
+                distance[vertex] = newDistance;
+                heap.insert(vertex, newDistance);
+            }
+        }
+
+    public:
+        Graph* graph;
+        MultiLevelPartition* partition;
+        vector<float> weights;                 // by road id
+        vector<vector<vector<int>>> boundary;  // boundary[level - 1][cell], boundary cities of the cell
+        vector<vector<int>> boundaryIndex;     // boundaryIndex[level - 1][vertex id], position in its cell's list or -1
+        vector<vector<int>> cliqueOffset;      // cliqueOffset[level - 1][cell], start of the cell's row major matrix
+        vector<vector<float>> cliques;         // cliques[level - 1]
+
+        OverlayGraph(Graph& graph, MultiLevelPartition& partition) {
+            this->graph = &graph;
+            this->partition = &partition;
+            distance.assign(graph.vertexCount(), infinity);
+
+            int levels = partition.levels;
+            boundary.resize(levels);
+            boundaryIndex.assign(levels, vector<int>(graph.vertexCount(), -1));
+            cliqueOffset.resize(levels);
+            cliques.resize(levels);
+
+            for (int level = 1; level <= levels; level++) {
+                boundary[level - 1].resize(partition.cellCount[level - 1]);
+                for (int v = 0; v < graph.vertexCount(); v++) {
+                    Vertex* vertex = graph.getVertex(v);
+                    for (int j = 0; j < vertex->neighbors.size(); j++) {
+                        if (partition.cellOf(level, vertex->neighbors[j]->id) != partition.cellOf(level, v)) {
+                            vector<int>& ends = boundary[level - 1][partition.cellOf(level, v)];
+                            boundaryIndex[level - 1][v] = ends.size();
+                            ends.push_back(v);
+                            break;
+                        }
+                    }
+                }
+
+                int offset = 0;
+                for (int c = 0; c < partition.cellCount[level - 1]; c++) {
+                    cliqueOffset[level - 1].push_back(offset);
+                    offset += boundary[level - 1][c].size() * boundary[level - 1][c].size();
+                }
+                cliques[level - 1].assign(offset, infinity);
+            }
+        }
+
+        // recomputes every clique bottom up for new road weights, O(boundary cities * cell search)
+        void customize(const vector<float>& roadWeights) {
+            TRACE_SPAN("customize overlay");
+            weights = roadWeights;
+            for (int level = 1; level <= partition->levels; level++) {
+                for (int c = 0; c < partition->cellCount[level - 1]; c++) {
+                    vector<int>& ends = boundary[level - 1][c];
+                    for (int i = 0; i < ends.size(); i++) {
+                        searchInCell(level, ends[i]);
+                        for (int j = 0; j < ends.size(); j++) {
+                            cliques[level - 1][cliqueOffset[level - 1][c] + i * ends.size() + j] = distance[ends[j]];
+                        }
+                        resetSearch();
+                    }
+                }
+            }
+        }
+
+        float clique(int level, int cell, int from, int to) {
+            return cliques[level - 1][cliqueOffset[level - 1][cell] + from * boundary[level - 1][cell].size() + to];
+        }
+
+        int cliqueEntries() {
+            int entries = 0;
+            for (int level = 0; level < cliques.size(); level++) entries += cliques[level].size();
+            return entries;
+        }
+};
+
+// point to point queries that search the roads only inside the source and destination cells and jump over every
+// other cell on the highest overlay level separating it from both ends. keeps scratch arrays, use one per thread
+class OverlayQuery {
+    private:
+        OverlayGraph* overlay;
+        vector<float> distance;
+        vector<int> parent;
+        vector<int> parentLevel; // 0 if reached by a road, else the level of the clique used
+        vector<bool> visited;
+        vector<int> touched;
+
+        // scratch of the clique unpacking searches, which run while the query's own arrays still hold its parents
+        vector<float> legDistance;
+        vector<int> legParent;
+        vector<bool> legDone;
+        vector<int> legTouched;
+
+        int queryLevel(int v, int source, int target) {
+            MultiLevelPartition* partition = overlay->partition;
+            for (int level = partition->levels; level >= 1; level--) {
+                int cell = partition->cellOf(level, v);
+                if (cell != partition->cellOf(level, source) && cell != partition->cellOf(level, target)) {
+                    return level;
+                }
+            }
+            return 0;
+        }
+
+        void relax(DistanceHeap& heap, int from, int to, float newDistance, int level) {
+            if (newDistance < distance[to]) {
+                if (distance[to] == infinity) touched.push_back(to);
+                distance[to] = newDistance;
+                parent[to] = from;
+                parentLevel[to] = level;
+                heap.insert(to, newDistance);
+            }
+        }
+
+        // cities strictly after from up to to along a clique, by searching the roads of the cell they share. O(E'*logV')
+        // for the V' cities and E' roads of the cell, the scratch is reset through the touched list
+        void unpackClique(int level, int from, int to, vector<int>& path) {
+            Graph* graph = overlay->graph;
+            int cell = overlay->partition->cellOf(level, from);
+            DistanceHeap heap;
+            legDistance[from] = 0;
+            legTouched.push_back(from);
+            heap.insert(from, 0);
+
+            while (!heap.isEmpty()) {
+                int current = heap.extractMin().second;
+                if (legDone[current]) continue;
+                legDone[current] = true;
+                if (current == to) break;
+
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || legDone[adjacent] || overlay->partition->cellOf(level, adjacent) != cell) continue;
+
+                    float newDistance = legDistance[current] + overlay->weights[road->id];
+                    if (newDistance < legDistance[adjacent]) {
+                        if (legDistance[adjacent] == infinity) legTouched.push_back(adjacent);
+                        legDistance[adjacent] = newDistance;
+                        legParent[adjacent] = current;
+                        heap.insert(adjacent, newDistance);
+                    }
+                }
+            }
+
+            if (legDistance[to] < infinity) {
+                int first = path.size();
+                for (int v = to; v != from; v = legParent[v]) path.push_back(v);
+                reverse(path.begin() + first, path.end());
+            }
+
+            for (int i = 0; i < legTouched.size(); i++) {
+                legDistance[legTouched[i]] = infinity;
+                legParent[legTouched[i]] = -1;
+                legDone[legTouched[i]] = false;
+            }
+            legTouched.clear();
+        }
+
+        float run(int source, int target) {
+            Graph* graph = overlay->graph;
+            MultiLevelPartition* partition = overlay->partition;
+            DistanceHeap heap;
+            distance[source] = 0;
+            touched.push_back(source);
+            heap.insert(source, 0);
+
+            while (!heap.isEmpty()) {
+                int current = heap.extractMin().second;
+                if (visited[current]) continue;
+                visited[current] = true;
+                if (current == target) return distance[target];
+
+                int level = queryLevel(current, source, target);
+                Vertex* currentVertex = graph->getVertex(current);
+                for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                    Road* road = currentVertex->roads[i];
+                    int adjacent = currentVertex->neighbors[i]->id;
+                    if (!road->open || visited[adjacent]) continue;
+                    // above level 0 only the roads leaving the cell are used, the clique covers the inside
+                    if (level > 0 && partition->cellOf(level, adjacent) == partition->cellOf(level, current)) continue;
+                    relax(heap, current, adjacent, distance[current] + overlay->weights[road->id], 0);
+                }
+                if (level > 0) {
+                    int cell = partition->cellOf(level, current);
+                    int from = overlay->boundaryIndex[level - 1][current];
+                    vector<int>& ends = overlay->boundary[level - 1][cell];
+                    for (int j = 0; j < ends.size(); j++) {
+                        if (!visited[ends[j]]) {
+                            relax(heap, current, ends[j], distance[current] + overlay->clique(level, cell, from, j), level);
+                        }
+                    }
+                }
+            }
+            return infinity;
+        }
+
+        void reset() {
+            for (int i = 0; i < touched.size(); i++) {
+                distance[touched[i]] = infinity;
+                parent[touched[i]] = -1;
+                parentLevel[touched[i]] = 0;
+                visited[touched[i]] = false;
+            }
+            touched.clear();
+        }
+
+    public:
+        OverlayQuery(OverlayGraph& overlay) {
+            this->overlay = &overlay;
+            int n = overlay.graph->vertexCount();
+            distance.assign(n, infinity);
+            parent.assign(n, -1);
+            parentLevel.assign(n, 0);
+            visited.assign(n, false);
+            legDistance.assign(n, infinity);
+            legParent.assign(n, -1);
+            legDone.assign(n, false);
+        }
+
+        // returns infinity if the cities are not connected
+        float getDistance(Vertex* from, Vertex* to) {
+            TRACE_SPAN("overlay distance");
+            float result = run(from->id, to->id);
+            reset();
+            return result;
+        }
+
+        // cities from source to destination, empty if they are not connected
+        vector<Vertex*> getShortestPath(Vertex* from, Vertex* to) {
+            TRACE_SPAN("overlay path unpack");
+            vector<Vertex*> path;
+            if (run(from->id, to->id) < infinity) {
+                vector<int> hops; // overlay hops backwards from the destination
+                for (int v = to->id; v != from->id; v = parent[v]) hops.push_back(v);
+
+                vector<int> vertices(1, from->id);
+                for (int i = hops.size() - 1; i >= 0; i--) {
+                    int v = hops[i];
+                    if (parentLevel[v] == 0) vertices.push_back(v);
+                    else unpackClique(parentLevel[v], parent[v], v, vertices);
+                }
+                for (int i = 0; i < vertices.size(); i++) {
+                    path.push_back(overlay->graph->getVertex(vertices[i]));
+                }
+            }
+            reset();
+            return path;
+        }
+};
+
+
+///////////////////////////////////////// Delta Stepping /////////////////////////////////////////
+
+// all threads wait until the last one arrives, spins with yield since the phases it separates are short
+class SpinBarrier {
+    private:
+        int count;
+        atomic<int> waiting;
+        atomic<int> generation;
+
+    public:
+        SpinBarrier(int count) : count(count), waiting(0), generation(0) {}
+
+        void wait() {
+            int gen = generation.load();
+            if (waiting.fetch_add(1) + 1 == count) {
+                waiting.store(0);
+                generation.fetch_add(1);
+            }
+            else {
+                while (generation.load() == gen) this_thread::yield();
+            }
+        }
+};
+
+// parallel one-to-all search (Meyer & Sanders): tentative distances are kept in buckets of width delta.
+// the lowest bucket is emptied by relaxing light arcs (weight <= delta) until it stays empty, then the heavy arcs of
+// everything it held are relaxed once. every thread owns its buckets and its share of each phase's work, and takes
+// chunks from the other threads' shares once its own is done. distances are the fixpoint of the same float sums as
+// the sequential dijkstra, so they are identical to Dijkstra::getShortestPathTree under the same weights
+class DeltaStepping {
+    private:
+        struct alignas(64) Worker {
+            vector<vector<int>> buckets;
+            vector<int> work;     // vertices of the current phase, others may steal from it
+            vector<int> settled;  // vertices that left the current bucket
+            atomic<int> cursor;   // next unclaimed position in work
+        };
+
+        CompactGraph* graph;
+        float delta;
+        int threads;
+
+        unique_ptr<atomic<float>[]> distance;
+        unique_ptr<atomic<bool>[]> inBucket;
+        unique_ptr<Worker[]> workers;
+        vector<int> nextBucket;
+        atomic<int> workSize[2];
+
+        static const int chunk = 64;
+
+        void relax(Worker& me, int vertex, float newDistance) {
+            float old = distance[vertex].load();
+            while (newDistance < old) {
+                if (distance[vertex].compare_exchange_weak(old, newDistance)) {
+                    int bucket = (int)(newDistance / delta);
+                    if (bucket >= me.buckets.size()) me.buckets.resize(bucket + 1);
+                    me.buckets[bucket].push_back(vertex);
+                    return;
+                }
+            }
+        }
+
+        // runs process on every vertex of every worker's work list, own list first
+        template <class Process>
+        void forEachWork(int self, Process process) {
+            for (int k = 0; k < threads; k++) {
+                Worker& owner = workers[(self + k) % threads];
+                int size = owner.work.size();
+                for (int begin = owner.cursor.fetch_add(chunk); begin < size; begin = owner.cursor.fetch_add(chunk)) {
+                    for (int i = begin; i < min(size, begin + chunk); i++) {
+                        process(owner.work[i]);
+                    }
+                }
+            }
+        }
+
+        void worker(int self, SpinBarrier& barrier) {
+            Worker& me = workers[self];
+            int current = 0, round = 0;
+
+            while (true) {
+                nextBucket[self] = INT_MAX;
+                for (int b = current; b < me.buckets.size(); b++) {
+                    if (!me.buckets[b].empty()) {
+                        nextBucket[self] = b;
+                        break;
+                    }
+                }
+                barrier.wait();
+                current = *min_element(nextBucket.begin(), nextBucket.end());
+                if (current == INT_MAX) return;
+                if (current >= me.buckets.size()) me.buckets.resize(current + 1);
+
+                // light arcs, until no thread puts anything back into the current bucket
+                while (true) {
+                    me.work.swap(me.buckets[current]);
+                    me.buckets[current].clear();
+                    me.cursor.store(0);
+                    workSize[round & 1].fetch_add(me.work.size());
+                    barrier.wait();
+                    int size = workSize[round & 1].load();
+                    if (self == 0) workSize[(round + 1) & 1].store(0);
+                    round++;
+                    if (size == 0) break;
+
+                    forEachWork(self, [&](int v) {
+                        float d = distance[v].load();
+                        if ((int)(d / delta) != current) return; // moved to a lower bucket meanwhile
+                        if (!inBucket[v].exchange(true)) me.settled.push_back(v);
+
+                        int heavy = graph->firstHeavyArc(v, delta);
+                        for (int a = graph->firstArc[v]; a < heavy; a++) {
+                            relax(me, graph->arcHead[a], d + graph->arcWeight[a]);
+                        }
+                    });
+                    barrier.wait();
+                }
+
+                // heavy arcs, once for every vertex that was in the bucket
+                me.work.swap(me.settled);
+                me.settled.clear();
+                me.cursor.store(0);
+                barrier.wait();
+                forEachWork(self, [&](int v) {
+                    float d = distance[v].load();
+                    for (int a = graph->firstHeavyArc(v, delta); a < graph->firstArc[v + 1]; a++) {
+                        relax(me, graph->arcHead[a], d + graph->arcWeight[a]);
+                    }
+                });
+                barrier.wait();
+                for (int i = 0; i < me.work.size(); i++) inBucket[me.work[i]].store(false);
+                current++;
+            }
+        }
+
+    public:
+        // a delta around the average arc weight balances the number of buckets against re-relaxations within one.
+        // delta must be positive, otherwise every search returns an empty tree (source -1)
+        DeltaStepping(CompactGraph& graph, float delta, int threads = thread::hardware_concurrency()) {
+            this->graph = &graph;
+            this->delta = delta;
+            this->threads = max(1, threads);
+            distance.reset(new atomic<float>[graph.vertexCount]);
+            inBucket.reset(new atomic<bool>[graph.vertexCount]);
+            workers.reset(new Worker[this->threads]);
+            nextBucket.assign(this->threads, INT_MAX);
+        }
+
+        ShortestPathTree getShortestPathTree(int source) {
+            TRACE_SPAN("delta stepping");
+            if (!(delta > 0)) {
+                return ShortestPathTree();
+            }
+            int n = graph->vertexCount;
+            for (int v = 0; v < n; v++) {
+                distance[v].store(infinity);
+                inBucket[v].store(false);
+            }
+            for (int t = 0; t < threads; t++) {
+                workers[t].buckets.clear();
+                workers[t].settled.clear();
+            }
+            workSize[0].store(0);
+            workSize[1].store(0);
+            relax(workers[0], source, 0);
+
+            SpinBarrier barrier(threads);
+            vector<thread> team;
+            for (int t = 1; t < threads; t++) {
+                team.push_back(thread(&DeltaStepping::worker, this, t, ref(barrier)));
+            }
+            worker(0, barrier);
+            for (int t = 0; t < team.size(); t++) team[t].join();
+
+            // parents are picked afterwards, racing updates cannot leave them consistent with the distances
+            ShortestPathTree tree(source, n);
+            for (int v = 0; v < n; v++) tree.distance[v] = distance[v].load();
+            for (int v = 0; v < n; v++) {
+                if (v == source || tree.distance[v] >= infinity) continue;
+                for (int a = graph->firstArc[v]; a < graph->firstArc[v + 1]; a++) {
+                    int u = graph->arcHead[a];
+                    if (tree.distance[u] < tree.distance[v] && tree.distance[u] + graph->arcWeight[a] == tree.distance[v]) {
+                        tree.parent[v] = u;
+                        tree.parentRoad[v] = graph->arcRoad[a];
+                        break;
+                    }
+                }
+            }
+            return tree;
+        }
+};
+
+
+///////////////////////////////////////// Hub Labels /////////////////////////////////////////
+
+// exact distance oracle (pruned landmark labeling): every city keeps a label of (hub, distance) pairs such that
+// any two connected cities share a hub on one of their shortest paths, so a query is a merge of two sorted labels.
+// hubs are taken from most to least important (the top of the contraction hierarchy first), each one a dijkstra
+// pruned wherever the labels built so far already give the distance. hubs are numbered in that order so the labels
+// come out sorted. labels are stored as 8 byte entries in one array, each label starting on its own 64 byte cache
+// line and ending with a sentinel hub, so the merge reads whole lines and needs no bounds checks
+class HubLabels {
+    private:
+        struct HubEntry {
+            int hub;
+            float distance;
+        };
+
+        // hands out cache line aligned memory, so that entry 8*k starts a line
+        template <class T>
+        struct CacheLineAllocator {
+            typedef T value_type;
+
+            CacheLineAllocator() = default;
+            template <class U>
+            CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+            T* allocate(size_t count) { return (T*)::operator new(count * sizeof(T), align_val_t(64)); }
+            void deallocate(T* memory, size_t) { ::operator delete(memory, align_val_t(64)); }
+
+            template <class U>
+            bool operator==(const CacheLineAllocator<U>&) const { return true; }
+            template <class U>
+            bool operator!=(const CacheLineAllocator<U>&) const { return false; }
+        };
+
+        static const int sentinel = INT_MAX;
+        static const int entriesPerLine = 64 / sizeof(HubEntry);
+
+        vector<HubEntry, CacheLineAllocator<HubEntry>> labelEntries;
+        vector<int> labelStart; // first entry of each city's label, a multiple of entriesPerLine
+        int entries;
+
+        void build(Graph& graph, const vector<float>& weights, const vector<int>& order) {
+            TRACE_SPAN("hub labels");
+            int n = graph.vertexCount();
+            vector<vector<HubEntry>> labels(n);
+            vector<float> hubDistance(n, numeric_limits<float>::infinity()); // label of the current hub, by hub number
+            vector<float> distance(n, numeric_limits<float>::infinity());
+            vector<int> touched;
+
+            for (int h = 0; h < order.size(); h++) {
+                int root = order[h];
+                for (int i = 0; i < labels[root].size(); i++) hubDistance[labels[root][i].hub] = labels[root][i].distance;
+
+                DistanceHeap heap;
+                distance[root] = 0;
+                touched.push_back(root);
+                heap.insert(root, 0);
+                while (!heap.isEmpty()) {
+                    pair<float, int> entry = heap.extractMin();
+                    int current = entry.second;
+                    if (entry.first > distance[current]) continue; // stale entry
+
+                    // prune if the hubs found so far already cover this distance
+                    float known = numeric_limits<float>::infinity();
+                    for (int i = 0; i < labels[current].size(); i++) {
+                        known = min(known, hubDistance[labels[current][i].hub] + labels[current][i].distance);
+                    }
+                    if (known <= distance[current]) continue;
+
+                    HubEntry label = { h, distance[current] };
+                    labels[current].push_back(label);
+
+                    Vertex* currentVertex = graph.getVertex(current);
+                    for (int i = 0; i < currentVertex->neighbors.size(); i++) {
+                        Road* road = currentVertex->roads[i];
+                        int adjacent = currentVertex->neighbors[i]->id;
+                        float newDistance = distance[current] + weights[road->id];
+                        if (road->open && newDistance < distance[adjacent]) {
+                            if (distance[adjacent] == numeric_limits<float>::infinity()) touched.push_back(adjacent);
+                            distance[adjacent] = newDistance;
+                            heap.insert(adjacent, newDistance);
+                        }
+                    }
+                }
+
+                for (int i = 0; i < touched.size(); i++) distance[touched[i]] = numeric_limits<float>::infinity();
+                touched.clear();
+                for (int i = 0; i < labels[root].size(); i++) hubDistance[labels[root][i].hub] = numeric_limits<float>::infinity();
+            }
+
+            // flatten, padding every label (plus its sentinel) to whole cache lines
+            entries = 0;
+            int total = 0;
+            for (int v = 0; v < n; v++) {
+                total += (labels[v].size() + entriesPerLine) / entriesPerLine * entriesPerLine;
+            }
+            labelEntries.assign(total, HubEntry{ sentinel, 0 });
+            labelStart.assign(n, 0);
+            for (int v = 0, next = 0; v < n; v++) {
+                labelStart[v] = next;
+                copy(labels[v].begin(), labels[v].end(), labelEntries.begin() + next);
+                next += (labels[v].size() + entriesPerLine) / entriesPerLine * entriesPerLine; // the sentinel is already there
+                entries += labels[v].size();
+                vector<HubEntry>().swap(labels[v]);
+            }
+        }
+
+    public:
+        // order lists the cities from most to least important
+        HubLabels(Graph& graph, const vector<float>& weights, const vector<int>& order) {
+            build(graph, weights, order);
+        }
+
+        // hub order from the top of the hierarchy down
+        HubLabels(Graph& graph, const vector<float>& weights, ContractionHierarchy& hierarchy) {
+            build(graph, weights, vector<int>(hierarchy.vertexOfRank.rbegin(), hierarchy.vertexOfRank.rend()));
+        }
+
+        // returns infinity if the cities are not connected
+        float getDistance(Vertex* from, Vertex* to) { // O(|label(from)| + |label(to)|)
+            const HubEntry* a = labelEntries.data() + labelStart[from->id];
+            const HubEntry* b = labelEntries.data() + labelStart[to->id];
+            float best = numeric_limits<float>::infinity();
+            while (true) {
+                if (a->hub == b->hub) {
+                    if (a->hub == sentinel) break;
+                    best = min(best, a->distance + b->distance);
+                    a++;
+                    b++;
+                }
+                else if (a->hub < b->hub) a++;
+                else b++;
+            }
+            return best == numeric_limits<float>::infinity() ? infinity : best;
+        }
+
+        double averageLabelSize() {
+            return labelStart.empty() ? 0 : (double)entries / labelStart.size();
+        }
+
+        size_t memoryBytes() {
+            return labelEntries.size() * sizeof(HubEntry) + labelStart.size() * sizeof(int);
+        }
+};
+
+
+///////////////////////////////////////// Result Cache /////////////////////////////////////////
+
+// shortest paths kept in a memory mapped file, so a restarted process answers the pairs it has seen
+// before without searching. entries are keyed by the fingerprint of the graph (cities, roads and their lengths, tolls,
+// speeds and closures), the fingerprint of the metric's weights and the pair of cities, so nothing computed on another
+// map or metric is ever returned. the file holds an open addressing table of fixed size slots and an arena for the
+// paths; opening it for a different graph than the one it was last used with empties it. capacity is fixed when the
+// file is created, a full cache just stops taking entries. one process at a time (open() fails while another holds
+// the file), any number of threads
+class ResultCache {
+    private:
+        struct Header {
+            char magic[8];
+            int format;
+            int slotCount;                // power of two
+            int arenaCount;               // vertex ids the arena holds
+            int used;                     // slots filled
+            int arenaUsed;
+            unsigned long long graph;     // fingerprint the entries were last validated against
+        };
+
+        struct Slot {
+            unsigned long long graph;
+            unsigned long long metric;
+            int from, to;                 // from <= to, roads are undirected
+            float distance;
+            int pathStart;                // first vertex id in the arena
+            int pathLength;
+            int filled;                   // written last, a slot torn by a crash stays empty
+        };
+
+        static const int format = 1;
+
+        string path;
+        char* data;
+        size_t bytes;
+        Header* header;
+        Slot* slots;
+        int* arena;
+        mutex lock;
+#ifdef _WIN32
+        HANDLE file, mapping;
+#else
+        int file;
+#endif
+
+        static unsigned long long mix(unsigned long long hash, const void* bytes, size_t count) { // FNV-1a
+            const unsigned char* p = (const unsigned char*)bytes;
+            for (size_t i = 0; i < count; i++) {
+                hash ^= p[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        template <class T>
+        static unsigned long long mix(unsigned long long hash, const T& value) {
+            return mix(hash, &value, sizeof(T));
+        }
+
+        // a file that is neither empty nor starts with the cache magic is left untouched and false returned, as is one
+        // that another process (or another ResultCache) holds: the lock is taken before anything is read or resized
+        bool mapFile(size_t size) {
+            char magic[8] = {};
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            OVERLAPPED whole = {};
+            if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &whole)) {
+                CloseHandle(file); // released with the handle
+                return false;
+            }
+            LARGE_INTEGER existing;
+            DWORD read = 0;
+            OVERLAPPED start = {};
+            if (!GetFileSizeEx(file, &existing)
+                || (existing.QuadPart > 0 && (!ReadFile(file, magic, sizeof(magic), &read, &start) || read != sizeof(magic) || memcmp(magic, "FXCACHE", 8) != 0))) {
+                CloseHandle(file);
+                return false;
+            }
+            if ((size_t)existing.QuadPart != size) {
+                LARGE_INTEGER wanted;
+                wanted.QuadPart = size;
+                if (!SetFilePointerEx(file, wanted, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+                    CloseHandle(file);
+                    return false;
+                }
+            }
+            mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xffffffffULL), NULL);
+            if (mapping == NULL) {
+                CloseHandle(file);
+                return false;
+            }
+            data = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+            if (data == NULL) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return false;
+            }
+#else
+            file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (file < 0) {
+                return false;
+            }
+            if (flock(file, LOCK_EX | LOCK_NB) != 0) {
+                ::close(file); // released with the descriptor
+                return false;
+            }
+            struct stat status;
+            if (fstat(file, &status) != 0 || (status.st_size > 0 && (pread(file, magic, sizeof(magic), 0) != sizeof(magic) || memcmp(magic, "FXCACHE", 8) != 0))
+                || ((size_t)status.st_size != size && ftruncate(file, size) != 0)) {
+                ::close(file);
+                return false;
+            }
+            void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(file);
+                return false;
+            }
+            data = (char*)mapped;
+#endif
+            bytes = size;
+            return true;
+        }
+
+        void unmapFile() {
+#ifdef _WIN32
+            FlushViewOfFile(data, 0);
+            UnmapViewOfFile(data);
+            CloseHandle(mapping);
+            CloseHandle(file);
+#else
+            msync(data, bytes, MS_SYNC);
+            munmap(data, bytes);
+            ::close(file);
+#endif
+            data = NULL;
+        }
+
+        void clear(unsigned long long graph) {
+            memset(slots, 0, sizeof(Slot) * header->slotCount);
+            header->used = 0;
+            header->arenaUsed = 0;
+            header->graph = graph;
+        }
+
+        static unsigned long long slotHash(unsigned long long graph, unsigned long long metric, int from, int to) {
+            return mix(mix(mix(mix(14695981039346656037ULL, graph), metric), from), to);
+        }
+
+        // the slot holding the key, or the empty slot where it would go, NULL if the table is full and it is absent
+        Slot* find(unsigned long long graph, unsigned long long metric, int from, int to) {
+            int mask = header->slotCount - 1;
+            for (int i = slotHash(graph, metric, from, to) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+                Slot* slot = &slots[i];
+                if (!slot->filled || (slot->graph == graph && slot->metric == metric && slot->from == from && slot->to == to)) return slot;
+            }
+            return NULL;
+        }
+
+        // the empty slot for a new key, NULL once the table is three quarters full (to keep probes short) or if the key is held
+        Slot* claim(unsigned long long graph, unsigned long long metric, int from, int to) {
+            if (header->used * 4 >= header->slotCount * 3) {
+                return NULL;
+            }
+            Slot* slot = find(graph, metric, from, to);
+            return slot != NULL && !slot->filled ? slot : NULL;
+        }
+
+        void fill(Slot* slot, unsigned long long graph, unsigned long long metric, int from, int to, float distance, int pathStart, int pathLength) {
+            slot->graph = graph;
+            slot->metric = metric;
+            slot->from = from;
+            slot->to = to;
+            slot->distance = distance;
+            slot->pathStart = pathStart;
+            slot->pathLength = pathLength;
+            atomic_thread_fence(memory_order_release);
+            slot->filled = 1;
+            header->used++;
+        }
+
+    public:
+        ResultCache() {
+            data = NULL;
+            bytes = 0;
+            header = NULL;
+            slots = NULL;
+            arena = NULL;
+        }
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        ~ResultCache() {
+            close();
+        }
+
+        static unsigned long long fingerprint(Graph& graph) { // O(V+E)
+            unsigned long long hash = mix(14695981039346656037ULL, graph.vertexCount());
+            for (int i = 0; i < graph.vertexCount(); i++) {
+                Vertex* v = graph.getVertex(i);
+                hash = mix(hash, v->city.data(), v->city.size());
+                hash = mix(mix(hash, v->latitude), v->longitude);
+            }
+            hash = mix(hash, graph.roadCount());
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                hash = mix(mix(hash, road->from->id), road->to->id);
+                hash = mix(mix(mix(hash, road->distance), road->toll), road->speed);
+                hash = mix(hash, (char)road->open);
+            }
+            return hash;
+        }
+
+        static unsigned long long fingerprint(const vector<float>& weights) { // O(E)
+            return mix(mix(14695981039346656037ULL, weights.size()), weights.data(), weights.size() * sizeof(float));
+        }
+
+        // maps the file, creating it with room for slotCount entries and arenaCount path vertices if it does not exist
+        // or is an older cache that does not match. false if it cannot be mapped, is in use or holds something other than a
+        // cache
+        bool open(const string& path, unsigned long long graph, int slotCount = 1 << 18, int arenaCount = 1 << 22) {
+            TRACE_SPAN("open result cache");
+            lock_guard<mutex> guard(lock);
+            if (data != NULL) unmapFile();
+            this->path = path;
+            int capacity = 1;
+            while (capacity < slotCount) capacity *= 2;
+
+            // an existing file keeps its own capacity if its header is sound
+            ifstream existing(path, ios::binary);
+            Header stored;
+            if (existing.read((char*)&stored, sizeof(Header)) && memcmp(stored.magic, "FXCACHE", 8) == 0 && stored.format == format
+                && stored.slotCount > 0 && (stored.slotCount & (stored.slotCount - 1)) == 0 && stored.arenaCount >= 0) {
+                capacity = stored.slotCount;
+                arenaCount = stored.arenaCount;
+            }
+            existing.close();
+
+            size_t size = sizeof(Header) + sizeof(Slot) * (size_t)capacity + sizeof(int) * (size_t)arenaCount;
+            if (!mapFile(size)) {
+                return false;
+            }
+            header = (Header*)data;
+            slots = (Slot*)(data + sizeof(Header));
+            arena = (int*)(data + sizeof(Header) + sizeof(Slot) * (size_t)capacity);
+
+            bool sound = memcmp(header->magic, "FXCACHE", 8) == 0 && header->format == format && header->slotCount == capacity
+                && header->arenaCount == arenaCount && header->used >= 0 && header->used <= capacity
+                && header->arenaUsed >= 0 && header->arenaUsed <= arenaCount;
+            if (!sound) {
+                memcpy(header->magic, "FXCACHE", 8);
+                header->format = format;
+                header->slotCount = capacity;
+                header->arenaCount = arenaCount;
+                clear(graph);
+            }
+            else if (header->graph != graph) {
+                clear(graph); // another map was loaded since
+            }
+            return true;
+        }
+
+        bool isOpen() {
+            return data != NULL;
+        }
+
+        // reads every page once so the first queries after a restart do not fault them in one by one. returns the entries held
+        int warm() {
+            TRACE_SPAN("warm result cache");
+            lock_guard<mutex> guard(lock);
+            if (data == NULL) {
+                return 0;
+            }
+            size_t used = sizeof(Header) + sizeof(Slot) * (size_t)header->slotCount + sizeof(int) * (size_t)header->arenaUsed;
+#ifndef _WIN32
+            madvise(data, used, MADV_WILLNEED);
+#endif
+            volatile char sink = 0;
+            for (size_t i = 0; i < used; i += 4096) sink = sink + data[i];
+            return header->used;
+        }
+
+        int size() {
+            lock_guard<mutex> guard(lock);
+            return data == NULL ? 0 : header->used;
+        }
+
+        // vertex ids from one city to the other, false unless the pair is cached
+        bool getPath(unsigned long long graph, unsigned long long metric, int from, int to, vector<int>& vertices, float& distance) {
+            lock_guard<mutex> guard(lock);
+            if (data == NULL) {
+                return false;
+            }
+            Slot* slot = find(graph, metric, min(from, to), max(from, to));
+            if (slot == NULL || !slot->filled) {
+                return false;
+            }
+            vertices.assign(arena + slot->pathStart, arena + slot->pathStart + slot->pathLength);
+            if (from > to) reverse(vertices.begin(), vertices.end());
+            distance = slot->distance;
+            return true;
+        }
+
+        void putPath(unsigned long long graph, unsigned long long metric, const vector<int>& vertices, float distance) {
+            lock_guard<mutex> guard(lock);
+            if (data == NULL || vertices.empty() || header->arenaUsed + (int)vertices.size() > header->arenaCount) {
+                return;
+            }
+            int from = vertices.front(), to = vertices.back();
+            Slot* slot = claim(graph, metric, min(from, to), max(from, to));
+            if (slot == NULL) {
+                return; // full, or the path is already known
+            }
+            int start = header->arenaUsed;
+            if (from <= to) copy(vertices.begin(), vertices.end(), arena + start);
+            else copy(vertices.rbegin(), vertices.rend(), arena + start);
+            header->arenaUsed += vertices.size();
+            fill(slot, graph, metric, min(from, to), max(from, to), distance, start, vertices.size());
+        }
+
+        void flush() {
+            lock_guard<mutex> guard(lock);
+            if (data == NULL) {
+                return;
+            }
+#ifdef _WIN32
+            FlushViewOfFile(data, 0);
+#else
+            msync(data, bytes, MS_ASYNC);
+#endif
+        }
+
+        void close() {
+            lock_guard<mutex> guard(lock);
+            if (data != NULL) unmapFile();
+        }
+};
+
+
+///////////////////////////////////////// Graph Snapshots /////////////////////////////////////////
+
+string trim(const string& text) {
+    int begin = 0, end = text.size();
+    while (begin < end && isspace((unsigned char)text[begin])) begin++;
+    while (end > begin && isspace((unsigned char)text[end - 1])) end--;
+    return text.substr(begin, end - begin);
+}
+
+// reads cities.csv: city, latitude, longitude, then the neighboring cities, one city per row.
+// all cities are added before any road so that rows can name cities further down. returns false if the file cannot be read
+bool loadMapFromCsv(const string& path, LinkedList& cities, Graph& graph) {
+    TRACE_SPAN("load map csv");
+    ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    vector<vector<string>> rows;
+    {
+        TRACE_SPAN("parse csv");
+        string line;
+        getline(file, line); // header
+        while (getline(file, line)) {
+            vector<string> fields;
+            stringstream row(line);
+            string field;
+            while (getline(row, field, ',')) fields.push_back(trim(field));
+            if (fields.size() >= 3 && !fields[0].empty()) rows.push_back(fields);
+        }
+    }
+
+    for (int i = 0; i < rows.size(); i++) {
+        float latitude = atof(rows[i][1].c_str());
+        float longitude = atof(rows[i][2].c_str());
+        cities.addNode(rows[i][0], latitude, longitude);
+        graph.addVertex(rows[i][0], latitude, longitude);
+    }
+    for (int i = 0; i < rows.size(); i++) {
+        for (int j = 3; j < rows[i].size(); j++) {
+            if (!rows[i][j].empty()) graph.addEdge(rows[i][0], rows[i][j]);
+        }
+    }
+    return true;
+}
+
+// binary map file, native byte order: "FXMAP" and a format version, then the cities (name length, name, latitude,
+// longitude) and the roads (endpoint ids, km, toll, speed, open) in id order, so ids survive a save and load
+const char map_magic[] = "FXMAP";
+const int map_format = 1;
+
+template <class T>
+void writeValue(ostream& out, const T& value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <class T>
+bool readValue(istream& in, T& value) {
+    return (bool)in.read((char*)&value, sizeof(T));
+}
+
+bool saveMapBinary(const string& path, Graph& graph) {
+    TRACE_SPAN("save map binary");
+    ofstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.write(map_magic, sizeof(map_magic));
+    writeValue(file, map_format);
+    writeValue(file, graph.vertexCount());
+    for (int i = 0; i < graph.vertexCount(); i++) {
+        Vertex* v = graph.getVertex(i);
+        writeValue(file, (int)v->city.size());
+        file.write(v->city.data(), v->city.size());
+        writeValue(file, v->latitude);
+        writeValue(file, v->longitude);
+    }
+    writeValue(file, graph.roadCount());
+    for (int i = 0; i < graph.roadCount(); i++) {
+        Road* road = graph.getRoad(i);
+        writeValue(file, road->from->id);
+        writeValue(file, road->to->id);
+        writeValue(file, road->distance);
+        writeValue(file, road->toll);
+        writeValue(file, road->speed);
+        writeValue(file, (char)road->open);
+    }
+    return (bool)file;
+}
+
+// into an empty list and graph. returns false if the file cannot be read or is not a map file of this format
+bool loadMapBinary(const string& path, LinkedList& cities, Graph& graph) {
+    TRACE_SPAN("load map binary");
+    ifstream file(path, ios::binary);
+    char magic[sizeof(map_magic)];
+    int format, vertexCount, roadCount;
+    if (!file || !file.read(magic, sizeof(magic)) || !equal(magic, magic + sizeof(magic), map_magic)
+        || !readValue(file, format) || format != map_format || !readValue(file, vertexCount) || vertexCount < 0) {
+        return false;
+    }
+    for (int i = 0; i < vertexCount; i++) {
+        int length;
+        float latitude, longitude;
+        if (!readValue(file, length) || length < 0 || length > 1 << 16) {
+            return false;
+        }
+        string city(length, ' ');
+        if (!file.read(&city[0], length) || !readValue(file, latitude) || !readValue(file, longitude)) {
+            return false;
+        }
+        cities.addNode(city, latitude, longitude);
+        graph.addVertex(city, latitude, longitude);
+    }
+    if (!readValue(file, roadCount) || roadCount < 0) {
+        return false;
+    }
+    for (int i = 0; i < roadCount; i++) {
+        int from, to;
+        float distance, toll, speed;
+        char open;
+        if (!readValue(file, from) || !readValue(file, to) || !readValue(file, distance) || !readValue(file, toll)
+            || !readValue(file, speed) || !readValue(file, open)) {
+            return false;
+        }
+        if (from < 0 || from >= vertexCount || to < 0 || to >= vertexCount || from == to) {
+            return false;
+        }
+        Road* road = graph.addEdge(graph.getVertex(from), graph.getVertex(to));
+        if (road->id != i) {
+            return false; // the same road twice
+        }
+        road->distance = distance;
+        road->toll = toll;
+        road->speed = speed;
+        road->open = open != 0;
+    }
+    return true;
+}
+
+// one version of the map with everything precomputed for it. never modified once published, so any number of
+// threads can query it: use the searches that keep their state outside the vertices (not Dijkstra::getShortestPath)
+class GraphSnapshot {
+    public:
+        long version;
+        LinkedList cities;
+        Graph graph;
+        unique_ptr<ConnectedComponents> components;
+        unique_ptr<CityIndex> names;
+        unique_ptr<ContractionHierarchy> hierarchy;
+        unique_ptr<CustomizedMetric> distances; // km on the hierarchy, for paths (one HierarchyQuery per thread)
+        atomic<int> references;                 // handles currently holding the snapshot
+        unsigned long long fingerprint;         // of the graph, and of the km weights, for the result cache
+        unsigned long long distanceFingerprint;
+
+        GraphSnapshot(long version) : version(version), references(0), fingerprint(0), distanceFingerprint(0) {}
+
+        // call once the graph is filled in
+        void buildIndexes() {
+            TRACE_SPAN("snapshot indexes");
+            components.reset(new ConnectedComponents(graph));
+            names.reset(new CityIndex(graph));
+            hierarchy.reset(new ContractionHierarchy(graph));
+            vector<float> weights = Metrics::distance(graph);
+            distances.reset(new CustomizedMetric(*hierarchy, weights));
+            fingerprint = ResultCache::fingerprint(graph);
+            distanceFingerprint = ResultCache::fingerprint(weights);
+        }
+
+        // NULL if the file cannot be read
+        static GraphSnapshot* fromCsv(const string& path, long version) {
+            GraphSnapshot* snapshot = new GraphSnapshot(version);
+            if (!loadMapFromCsv(path, snapshot->cities, snapshot->graph)) {
+                delete snapshot;
+                return NULL;
+            }
+            snapshot->buildIndexes();
+            return snapshot;
+        }
+
+        // a copy of a map built in memory, such as the one in main()
+        static GraphSnapshot* fromGraph(LinkedList& cities, Graph& graph, long version) {
+            GraphSnapshot* snapshot = new GraphSnapshot(version);
+            for (Node* node = cities.head; node != NULL; node = node->next) {
+                snapshot->cities.addNode(node->city, node->latitude, node->longitude);
+            }
+            for (int i = 0; i < graph.vertexCount(); i++) {
+                Vertex* v = graph.getVertex(i);
+                snapshot->graph.addVertex(v->city, v->latitude, v->longitude);
+            }
+            for (int i = 0; i < graph.roadCount(); i++) {
+                Road* road = graph.getRoad(i);
+                Road* copy = snapshot->graph.addEdge(snapshot->graph.getVertex(road->from->id), snapshot->graph.getVertex(road->to->id));
+                copy->distance = road->distance;
+                copy->toll = road->toll;
+                copy->speed = road->speed;
+                copy->open = road->open;
+            }
+            snapshot->buildIndexes();
+            return snapshot;
+        }
+
+        // from a file written by saveMapBinary, NULL if it cannot be read
+        static GraphSnapshot* fromBinary(const string& path, long version) {
+            GraphSnapshot* snapshot = new GraphSnapshot(version);
+            if (!loadMapBinary(path, snapshot->cities, snapshot->graph)) {
+                delete snapshot;
+                return NULL;
+            }
+            snapshot->buildIndexes();
+            return snapshot;
+        }
+};
+
+// counted reference to a snapshot, the snapshot outlives every handle to it
+class SnapshotHandle {
+    private:
+        GraphSnapshot* snapshot;
+
+    public:
+        SnapshotHandle(GraphSnapshot* snapshot) : snapshot(snapshot) {} // takes over a reference already counted
+        SnapshotHandle(SnapshotHandle&& other) : snapshot(other.snapshot) { other.snapshot = NULL; }
+        SnapshotHandle(const SnapshotHandle&) = delete;
+        SnapshotHandle& operator=(const SnapshotHandle&) = delete;
+
+        ~SnapshotHandle() {
+            if (snapshot != NULL) snapshot->references.fetch_sub(1);
+        }
+
+        GraphSnapshot* operator->() { return snapshot; }
+        GraphSnapshot& operator*() { return *snapshot; }
+};
+
+// RCU style publication of the current snapshot. readers never lock: acquire() pins the current snapshot in a
+// hazard slot, takes a reference and unpins it, retrying if a publish slipped in between. publish() swaps the
+// pointer atomically, so queries in flight finish on the old version while new ones get the new one, and the old
+// version is deleted by a later publish() or reclaim() once no handle or pin refers to it
+class SnapshotRegistry {
+    private:
+        static const int slots = 64; // readers inside acquire() at the same time, not readers holding handles
+
+        atomic<GraphSnapshot*> current;
+        atomic<GraphSnapshot*> hazards[slots];
+        atomic<bool> slotTaken[slots];
+        mutex publishing; // publishers only
+        vector<GraphSnapshot*> retired;
+
+        bool pinned(GraphSnapshot* snapshot) {
+            for (int i = 0; i < slots; i++) {
+                if (hazards[i].load() == snapshot) return true;
+            }
+            return false;
+        }
+
+    public:
+        SnapshotRegistry(GraphSnapshot* initial) : current(initial) {
+            for (int i = 0; i < slots; i++) {
+                hazards[i].store(NULL);
+                slotTaken[i].store(false);
+            }
+        }
+
+        ~SnapshotRegistry() {
+            reclaim();
+            delete current.load();
+        }
+
+        SnapshotHandle acquire() { // lock free
+            int slot = 0;
+            for (bool expected = false; !slotTaken[slot].compare_exchange_weak(expected, true); expected = false) {
+                slot = (slot + 1) % slots;
+            }
+
+            GraphSnapshot* snapshot;
+            do {
+                snapshot = current.load();
+                hazards[slot].store(snapshot);
+            } while (snapshot != current.load());
+
+            // the pin must be dropped only after the reference is counted, reclaim() checks them in the other order
+            snapshot->references.fetch_add(1);
+            hazards[slot].store(NULL);
+            slotTaken[slot].store(false);
+            return SnapshotHandle(snapshot);
+        }
+
+        long version() {
+            return current.load()->version;
+        }
+
+        // numbers next one above the current version, under the lock so that concurrent publishers never share a
+        // version, and returns that version
+        long publish(GraphSnapshot* next) {
+            lock_guard<mutex> lock(publishing);
+            next->version = current.load()->version + 1;
+            retired.push_back(current.exchange(next));
+            reclaimRetired();
+            return next->version;
+        }
+
+        // builds the next version from the file and publishes it, false (and nothing published) if it cannot be read
+        bool reloadFromCsv(const string& path) {
+            GraphSnapshot* next = GraphSnapshot::fromCsv(path, 0); // numbered by publish()
+            if (next == NULL) {
+                return false;
+            }
+            publish(next);
+            return true;
+        }
+
+        // the same for a file written by saveMapBinary
+        bool reloadFromBinary(const string& path) {
+            GraphSnapshot* next = GraphSnapshot::fromBinary(path, 0);
+            if (next == NULL) {
+                return false;
+            }
+            publish(next);
+            return true;
+        }
+
+        void reclaim() {
+            lock_guard<mutex> lock(publishing);
+            reclaimRetired();
+        }
+
+        int retiredCount() {
+            lock_guard<mutex> lock(publishing);
+            return retired.size();
+        }
+
+    private:
+        void reclaimRetired() {
+            for (int i = 0; i < retired.size(); i++) {
+                if (!pinned(retired[i]) && retired[i]->references.load() == 0) {
+                    delete retired[i];
+                    retired.erase(retired.begin() + i);
+                    i--;
+                }
+            }
+        }
+};
+
+
+///////////////////////////////////////// OpenStreetMap Import /////////////////////////////////////////
+
+// tag by tag reader for OSM XML, reading the file in 1 MB chunks. only what the importer needs: element names,
+// closing and self closing tags, attributes with the five predefined entities decoded. comments and declarations are skipped
+class OsmXmlReader {
+    private:
+        istream* in;
+        vector<char> buffer;
+        int position, filled;
+        string raw; // text between '<' and '>'
+
+        int get() {
+            if (position == filled) {
+                in->read(buffer.data(), buffer.size());
+                filled = in->gcount();
+                position = 0;
+                if (filled == 0) return -1;
+            }
+            return (unsigned char)buffer[position++];
+        }
+
+        static string decode(const string& text) {
+            if (text.find('&') == string::npos) {
+                return text;
+            }
+            const char* entities[][2] = { { "&amp;", "&" }, { "&lt;", "<" }, { "&gt;", ">" }, { "&quot;", "\"" }, { "&apos;", "'" } };
+            string result;
+            for (int i = 0; i < text.size(); i++) {
+                bool replaced = false;
+                for (int e = 0; e < 5 && !replaced; e++) {
+                    if (text.compare(i, strlen(entities[e][0]), entities[e][0]) == 0) {
+                        result += entities[e][1];
+                        i += strlen(entities[e][0]) - 1;
+                        replaced = true;
+                    }
+                }
+                if (!replaced) result += text[i];
+            }
+            return result;
+        }
+
+    public:
+        string name;      // element name, without the '/' of a closing tag
+        bool closing;     // </name>
+        bool selfClosing; // <name ... />
+        vector<pair<string, string>> attributes;
+
+        OsmXmlReader(istream& in) : buffer(1 << 20) {
+            this->in = &in;
+            position = 0;
+            filled = 0;
+            closing = false;
+            selfClosing = false;
+        }
+
+        // moves to the next element tag, false at the end of the input
+        bool next() {
+            while (true) {
+                int c;
+                while ((c = get()) != '<') {
+                    if (c == -1) return false;
+                }
+                raw.clear();
+                char quote = 0;
+                while ((c = get()) != -1) {
+                    if (c == '>' && quote == 0) {
+                        bool inComment = raw.compare(0, 3, "!--") == 0 && (raw.size() < 5 || raw.compare(raw.size() - 2, 2, "--") != 0);
+                        if (!inComment) break;
+                    }
+                    if ((c == '"' || c == '\'') && !raw.empty() && raw[0] != '!') { // '>' may appear inside attribute values
+                        if (quote == 0) quote = c;
+                        else if (quote == c) quote = 0;
+                    }
+                    raw += (char)c;
+                }
+                if (c == -1) return false;
+                if (raw.empty() || raw[0] == '!' || raw[0] == '?') continue;
+
+                closing = raw[0] == '/';
+                selfClosing = raw[raw.size() - 1] == '/';
+                int i = closing ? 1 : 0, end = raw.size() - (selfClosing ? 1 : 0);
+                int begin = i;
+                while (i < end && !isspace((unsigned char)raw[i])) i++;
+                name.assign(raw, begin, i - begin);
+
+                attributes.clear();
+                while (i < end) {
+                    while (i < end && isspace((unsigned char)raw[i])) i++;
+                    int keyBegin = i;
+                    while (i < end && raw[i] != '=' && !isspace((unsigned char)raw[i])) i++;
+                    string key = raw.substr(keyBegin, i - keyBegin);
+                    while (i < end && raw[i] != '"' && raw[i] != '\'') i++;
+                    if (i >= end) break;
+                    char delimiter = raw[i++];
+                    int valueBegin = i;
+                    while (i < end && raw[i] != delimiter) i++;
+                    attributes.push_back(make_pair(key, decode(raw.substr(valueBegin, i - valueBegin))));
+                    i++;
+                }
+                return true;
+            }
+        }
+
+        // NULL if the tag has no such attribute
+        const string* attribute(const char* key) {
+            for (int i = 0; i < attributes.size(); i++) {
+                if (attributes[i].first == key) return &attributes[i].second;
+            }
+            return NULL;
+        }
+};
+
+// builds the road graph from an OSM XML extract in two streaming passes, so memory grows with the kept roads and
+// not with the file: the first pass keeps the ways whose highway tag is selected (their node ids, in one flat list),
+// the second reads the coordinates of only the nodes on those ways. a city is made for every routing node (the end of
+// a kept way, a node shared by two of them, or a node next to where the extract's border clips a way) named
+// "osm:<node id>", and a road for every stretch of way between two routing nodes, its length the haversine sum over
+// the nodes in between and its speed the maxspeed tag or a default for the highway class. roads stay undirected,
+// oneway tags are ignored. nodes must come before ways, as in every extract published by planet.openstreetmap.org
+// and geofabrik. PBF input needs a protobuf and zlib decoder and is not supported, convert it first
+// (osmium cat extract.osm.pbf -o extract.osm)
+class OsmImporter {
+    private:
+        set<string> highways;
+
+        // ways kept by the first pass
+        vector<long long> wayNodes; // node ids of all kept ways, one way after the other
+        vector<int> wayStart;       // first entry of each way in wayNodes, plus the end
+        vector<float> waySpeed;     // km/h
+
+        // nodes on kept ways, sorted by id, with what the second pass found
+        vector<long long> needed;
+        vector<bool> routing;
+        vector<bool> located;
+        vector<float> latitude, longitude;
+
+        int indexOf(long long node) { // position in needed, which holds every node of a kept way
+            return lower_bound(needed.begin(), needed.end(), node) - needed.begin();
+        }
+
+        void readWays(istream& in) {
+            TRACE_SPAN("osm ways pass");
+            OsmXmlReader reader(in);
+            vector<long long> nodes;
+            string highway, maxspeed;
+            bool inWay = false;
+            wayStart.assign(1, 0);
+            while (reader.next()) {
+                if (reader.name == "node") {
+                    if (!reader.closing) nodeCount++;
+                }
+                else if (reader.name == "way") {
+                    if (!reader.closing) {
+                        wayCount++;
+                        nodes.clear();
+                        highway.clear();
+                        maxspeed.clear();
+                        inWay = !reader.selfClosing;
+                    }
+                    else if (inWay) {
+                        inWay = false;
+                        if (nodes.size() >= 2 && highways.count(highway)) {
+                            wayNodes.insert(wayNodes.end(), nodes.begin(), nodes.end());
+                            wayStart.push_back(wayNodes.size());
+                            float speed = parseSpeed(maxspeed);
+                            waySpeed.push_back(speed > 0 ? speed : defaultSpeed(highway));
+                        }
+                    }
+                }
+                else if (inWay && reader.name == "nd") {
+                    const string* ref = reader.attribute("ref");
+                    if (ref != NULL) nodes.push_back(atoll(ref->c_str()));
+                }
+                else if (inWay && reader.name == "tag") {
+                    const string* key = reader.attribute("k");
+                    const string* value = reader.attribute("v");
+                    if (key != NULL && value != NULL && *key == "highway") highway = *value;
+                    if (key != NULL && value != NULL && *key == "maxspeed") maxspeed = *value;
+                }
+            }
+        }
+
+        // a node is a routing node if it appears twice among the kept ways' nodes, with way ends counted twice
+        void findRoutingNodes() { // O(N*logN) for N kept way nodes
+            vector<long long> ids = wayNodes;
+            for (int w = 0; w + 1 < wayStart.size(); w++) {
+                ids.push_back(wayNodes[wayStart[w]]);
+                ids.push_back(wayNodes[wayStart[w + 1] - 1]);
+            }
+            sort(ids.begin(), ids.end());
+            needed.clear();
+            routing.clear();
+            for (int i = 0; i < ids.size(); ) {
+                int j = i;
+                while (j < ids.size() && ids[j] == ids[i]) j++;
+                needed.push_back(ids[i]);
+                routing.push_back(j - i >= 2);
+                i = j;
+            }
+            located.assign(needed.size(), false);
+            latitude.assign(needed.size(), 0);
+            longitude.assign(needed.size(), 0);
+        }
+
+        void readNodes(istream& in) {
+            TRACE_SPAN("osm nodes pass");
+            OsmXmlReader reader(in);
+            while (reader.next()) {
+                if (reader.name == "way" || reader.name == "relation") {
+                    break; // nodes come first
+                }
+                if (reader.name != "node" || reader.closing) continue;
+                const string* id = reader.attribute("id");
+                const string* lat = reader.attribute("lat");
+                const string* lon = reader.attribute("lon");
+                if (id == NULL || lat == NULL || lon == NULL) continue;
+                int i = indexOf(atoll(id->c_str()));
+                if (i < needed.size() && needed[i] == atoll(id->c_str())) {
+                    latitude[i] = atof(lat->c_str());
+                    longitude[i] = atof(lon->c_str());
+                    located[i] = true;
+                }
+            }
+        }
+
+        // a way clipped by the extract's border loses the nodes outside it, the located nodes on either side of such
+        // a gap end a stretch of the way just like its real ends
+        void markClippedEnds() {
+            for (int w = 0; w + 1 < wayStart.size(); w++) {
+                for (int k = wayStart[w]; k < wayStart[w + 1]; k++) {
+                    int i = indexOf(wayNodes[k]);
+                    if (!located[i]) continue;
+                    bool gapBefore = k > wayStart[w] && !located[indexOf(wayNodes[k - 1])];
+                    bool gapAfter = k + 1 < wayStart[w + 1] && !located[indexOf(wayNodes[k + 1])];
+                    if (gapBefore || gapAfter) routing[i] = true;
+                }
+            }
+        }
+
+        // nodes missing from the extract (ways clipped at its border) split their way
+        void buildGraph(LinkedList& cities, Graph& graph) {
+            TRACE_SPAN("osm build graph");
+            vector<int> vertexOf(needed.size(), -1);
+            for (int i = 0; i < needed.size(); i++) {
+                if (!routing[i] || !located[i]) continue;
+                string city = "osm:" + to_string(needed[i]);
+                vertexOf[i] = graph.vertexCount();
+                cities.addNode(city, latitude[i], longitude[i]);
+                graph.addVertex(city, latitude[i], longitude[i]);
+            }
+
+            for (int w = 0; w + 1 < wayStart.size(); w++) {
+                int start = -1, previous = -1;
+                double length = 0;
+                for (int k = wayStart[w]; k < wayStart[w + 1]; k++) {
+                    int i = indexOf(wayNodes[k]);
+                    if (!located[i]) {
+                        start = -1;
+                        previous = -1;
+                        continue;
+                    }
+                    if (previous != -1) length += haversine(latitude[previous], longitude[previous], latitude[i], longitude[i]);
+                    previous = i;
+                    if (vertexOf[i] == -1) continue;
+                    if (start != -1 && start != vertexOf[i]) {
+                        int before = graph.roadCount();
+                        Road* road = graph.addEdge(graph.getVertex(start), graph.getVertex(vertexOf[i]));
+                        if (graph.roadCount() > before || length < road->distance) { // parallel ways keep the shorter one
+                            road->distance = length;
+                            road->speed = waySpeed[w];
+                        }
+                    }
+                    start = vertexOf[i];
+                    length = 0;
+                }
+            }
+        }
+
+    public:
+        long long nodeCount; // in the file
+        long long wayCount;
+
+        static set<string> defaultHighways() { // roads between towns, with their ramps
+            return { "motorway", "motorway_link", "trunk", "trunk_link", "primary", "primary_link",
+                "secondary", "secondary_link", "tertiary", "tertiary_link" };
+        }
+
+        static float defaultSpeed(const string& highway) { // km/h
+            if (highway.compare(0, 8, "motorway") == 0) return highway == "motorway" ? 110 : 60;
+            if (highway.compare(0, 5, "trunk") == 0) return highway == "trunk" ? 90 : 50;
+            if (highway.compare(0, 7, "primary") == 0) return highway == "primary" ? 70 : 45;
+            if (highway.compare(0, 9, "secondary") == 0) return highway == "secondary" ? 60 : 40;
+            if (highway.compare(0, 8, "tertiary") == 0) return highway == "tertiary" ? 50 : 35;
+            return average_speed;
+        }
+
+        // "80", "50 mph", 0 for values such as "PK:urban" or "none"
+        static float parseSpeed(const string& maxspeed) {
+            float speed = atof(maxspeed.c_str());
+            if (maxspeed.find("mph") != string::npos) speed *= 1.609;
+            return speed > 0 ? speed : 0;
+        }
+
+        OsmImporter(const set<string>& highways = defaultHighways()) {
+            this->highways = highways;
+            nodeCount = 0;
+            wayCount = 0;
+        }
+
+        // into an empty list and graph, false if the file cannot be read
+        bool import(const string& path, LinkedList& cities, Graph& graph) {
+            TRACE_SPAN("osm import");
+            ifstream ways(path, ios::binary);
+            if (!ways) {
+                return false;
+            }
+            nodeCount = 0;
+            wayCount = 0;
+            wayNodes.clear();
+            waySpeed.clear();
+            readWays(ways);
+            findRoutingNodes();
+
+            ifstream nodes(path, ios::binary);
+            if (!nodes) {
+                return false;
+            }
+            readNodes(nodes);
+            markClippedEnds();
+            buildGraph(cities, graph);
+
+            // only the graph is kept
+            vector<long long>().swap(wayNodes);
+            vector<long long>().swap(needed);
+            vector<float>().swap(latitude);
+            vector<float>().swap(longitude);
+            return true;
+        }
+};
+
+
+///////////////////////////////////////// Benchmarks /////////////////////////////////////////
+
+// random cities spread over pakistan's bounding box, each joined by road to its nearest neighbors
+Graph* syntheticGraph(int cities, int neighbors, unsigned seed) {
+    const float minLat = 24.5, maxLat = 35.5, minLon = 62.0, maxLon = 75.0;
+    mt19937 random(seed);
+    uniform_real_distribution<float> latitude(minLat, maxLat), longitude(minLon, maxLon);
+
+    Graph* graph = new Graph();
+    for (int i = 0; i < cities; i++) {
+        graph->addVertex("City " + to_string(i), latitude(random), longitude(random));
+    }
+
+    // grid of about two cities per cell, the nearest neighbors are searched in growing rings of cells
+    int side = max(1, (int)sqrt(cities / 2.0));
+    vector<vector<int>> grid(side * side);
+    auto cellOf = [&](Vertex* v, int& row, int& column) {
+        row = min(side - 1, (int)((v->latitude - minLat) / (maxLat - minLat) * side));
+        column = min(side - 1, (int)((v->longitude - minLon) / (maxLon - minLon) * side));
+    };
+    for (int i = 0; i < cities; i++) {
+        int row, column;
+        cellOf(graph->getVertex(i), row, column);
+        grid[row * side + column].push_back(i);
+    }
+
+    for (int i = 0; i < cities; i++) {
+        Vertex* v = graph->getVertex(i);
+        int row, column;
+        cellOf(v, row, column);
+        vector<pair<double, int>> nearest;
+        for (int ring = 1; ring <= side && nearest.size() < neighbors + 1; ring++) {
+            nearest.clear();
+            for (int r = max(0, row - ring); r <= min(side - 1, row + ring); r++) {
+                for (int c = max(0, column - ring); c <= min(side - 1, column + ring); c++) {
+                    for (int k = 0; k < grid[r * side + c].size(); k++) {
+                        int other = grid[r * side + c][k];
+                        if (other != i) nearest.push_back(make_pair(v->calculateDistance(graph->getVertex(other)), other));
+                    }
+                }
+            }
+        }
+        int count = min((int)nearest.size(), neighbors);
+        partial_sort(nearest.begin(), nearest.begin() + count, nearest.end());
+        for (int k = 0; k < count; k++) {
+            graph->addEdge(v, graph->getVertex(nearest[k].second));
+        }
+    }
+    return graph;
+}
+
+double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// one-to-all searches from a few sources with 1 .. maxThreads threads. the speedup is against delta stepping on one
+// thread; how the compact graph on one thread compares to the sequential dijkstra is reported on its own line.
+// --check compares the trees with dijkstra
+void reportDeltaSteppingSpeedup(Graph& graph, int sources, int maxThreads, ostream& out) {
+    vector<float> weights = Metrics::distance(graph);
+    CompactGraph compact(graph, weights);
+    float delta = compact.averageArcWeight();
+
+    float checksum = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int s = 0; s < sources; s++) {
+        checksum += Dijkstra::getShortestPathTree(graph, graph.getVertex(s * graph.vertexCount() / sources), weights).distance[0];
+    }
+    double sequential = millisecondsSince(start) / sources;
+    out << "delta stepping, " << graph.vertexCount() << " cities, delta " << delta << " km" << endl;
+    out << "  dijkstra        " << sequential << " ms" << endl;
+
+    double single = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        DeltaStepping search(compact, delta, threads);
+        start = chrono::steady_clock::now();
+        for (int s = 0; s < sources; s++) {
+            checksum += search.getShortestPathTree(s * graph.vertexCount() / sources).distance[0];
+        }
+        double parallel = millisecondsSince(start) / sources;
+        if (threads == 1) single = parallel;
+        out << "  " << threads << " thread(s)    " << parallel << " ms, speedup " << single / parallel << endl;
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2; // end on maxThreads
+    }
+    volatile float sink = checksum; // keeps the timed loops from being optimized away
+    (void)sink;
+    out << "  1 thread against dijkstra " << sequential / single << "x (compact graph vs vertex objects)" << endl;
+}
+
+// label size, build time and query time of the hub labels against a dijkstra query on the same random pairs
+void reportHubLabels(Graph& graph, int queries, ostream& out) {
+    vector<float> weights = Metrics::distance(graph);
+    mt19937 random(7);
+    vector<pair<Vertex*, Vertex*>> pairs;
+    for (int i = 0; i < queries; i++) {
+        pairs.push_back(make_pair(graph.getVertex(random() % graph.vertexCount()), graph.getVertex(random() % graph.vertexCount())));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ContractionHierarchy hierarchy(graph);
+    HubLabels labels(graph, weights, hierarchy);
+    double build = millisecondsSince(start);
+
+    start = chrono::steady_clock::now();
+    float checksum = 0;
+    for (int i = 0; i < queries; i++) checksum += labels.getDistance(pairs[i].first, pairs[i].second);
+    double hubQuery = millisecondsSince(start) * 1000 / queries;
+
+    int dijkstraQueries = min(queries, 100);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < dijkstraQueries; i++) {
+        checksum -= Dijkstra::getShortestPathTree(graph, pairs[i].first, weights).distance[pairs[i].second->id];
+    }
+    double dijkstraQuery = millisecondsSince(start) * 1000 / dijkstraQueries;
+    volatile float sink = checksum; // keeps the timed loops from being optimized away
+    (void)sink;
+
+    out << "hub labels, " << graph.vertexCount() << " cities" << endl;
+    out << "  build           " << build << " ms (order included)" << endl;
+    out << "  label size      " << labels.averageLabelSize() << " hubs on average, " << labels.memoryBytes() / 1024 << " KiB" << endl;
+    out << "  query           " << hubQuery << " us" << endl;
+    out << "  dijkstra query  " << dijkstraQuery << " us" << endl;
+}
+
+// the two metric independent indexes side by side: contraction hierarchy and multi-level overlay, preprocessing,
+// customization for km and query time. --check compares their answers with dijkstra
+void reportCustomizableRouting(Graph& graph, int queries, ostream& out) {
+    vector<float> weights = Metrics::distance(graph);
+    mt19937 random(11);
+    vector<pair<Vertex*, Vertex*>> pairs;
+    for (int i = 0; i < queries; i++) {
+        pairs.push_back(make_pair(graph.getVertex(random() % graph.vertexCount()), graph.getVertex(random() % graph.vertexCount())));
+    }
+    float checksum = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        checksum += Dijkstra::getShortestPathTree(graph, pairs[i].first, weights).distance[pairs[i].second->id];
+    }
+    double dijkstraQuery = millisecondsSince(start) * 1000 / queries;
+
+    start = chrono::steady_clock::now();
+    ContractionHierarchy hierarchy(graph);
+    double hierarchyBuild = millisecondsSince(start);
+    start = chrono::steady_clock::now();
+    CustomizedMetric metric(hierarchy, weights);
+    double hierarchyCustomize = millisecondsSince(start);
+    HierarchyQuery hierarchyQuery(metric);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        checksum += hierarchyQuery.getDistance(pairs[i].first, pairs[i].second);
+    }
+    double hierarchyTime = millisecondsSince(start) * 1000 / queries;
+
+    start = chrono::steady_clock::now();
+    MultiLevelPartition partition(graph, { 64, 512, 4096 });
+    OverlayGraph overlay(graph, partition);
+    double overlayBuild = millisecondsSince(start);
+    start = chrono::steady_clock::now();
+    overlay.customize(weights);
+    double overlayCustomize = millisecondsSince(start);
+    OverlayQuery overlayQuery(overlay);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        checksum += overlayQuery.getDistance(pairs[i].first, pairs[i].second);
+    }
+    double overlayTime = millisecondsSince(start) * 1000 / queries;
+    volatile float sink = checksum; // keeps the timed loops from being optimized away
+    (void)sink;
+
+    out << "customizable routing, " << graph.vertexCount() << " cities" << endl;
+    out << "  hierarchy       " << hierarchyBuild << " ms preprocessing, " << hierarchyCustomize << " ms customization, "
+        << hierarchyTime << " us per query" << endl;
+    out << "  overlay         " << overlayBuild << " ms preprocessing, " << overlayCustomize << " ms customization, "
+        << overlayTime << " us per query" << endl;
+    out << "  dijkstra query  " << dijkstraQuery << " us" << endl;
+}
+
+// worst relative error of each distance policy over the roads of the graph, see Distance Policies
+void reportDistancePolicies(Graph& graph, ostream& out) {
+    out << "distance policies against vincenty, " << graph.roadCount() << " roads" << endl;
+    out << "  HaversineFloat  " << maxRelativeError<HaversineFloat>(graph) * 100 << " %" << endl;
+    out << "  HaversineDouble " << maxRelativeError<HaversineDouble>(graph) * 100 << " %" << endl;
+    out << "  Equirectangular " << maxRelativeError<Equirectangular>(graph) * 100 << " %" << endl;
+    out << "  RoadLength      " << maxRelativeError<RoadLength>(graph) * 100 << " %" << endl;
+}
+
+void runBenchmarks(Graph& graph) {
+    int cores = max(1u, thread::hardware_concurrency());
+    reportDistancePolicies(graph, cout);
+    reportDeltaSteppingSpeedup(graph, 8, cores, cout);
+    reportHubLabels(graph, 100000, cout);
+
+    Graph* large = syntheticGraph(200000, 3, 42);
+    reportDeltaSteppingSpeedup(*large, 4, cores, cout);
+    delete large;
+
+    Graph* medium = syntheticGraph(20000, 3, 42);
+    reportHubLabels(*medium, 100000, cout);
+    reportCustomizableRouting(*medium, 200, cout);
+    delete medium;
+}
+
+
+///////////////////////////////////////// Request Pipeline /////////////////////////////////////////
+
+#ifdef FAST_EXPLORER_ASYNC
+
+// fixed set of worker threads taking posted jobs in order
+class ThreadPool {
+    private:
+        vector<thread> workers;
+        deque<function<void()>> jobs;
+        mutex lock;
+        condition_variable available;
+        bool stopping;
+
+    public:
+        ThreadPool(int threads) {
+            stopping = false;
+            for (int t = 0; t < max(1, threads); t++) {
+                workers.push_back(thread([this]() {
+                    while (true) {
+                        function<void()> job;
+                        {
+                            unique_lock<mutex> guard(lock);
+                            available.wait(guard, [this]() { return stopping || !jobs.empty(); });
+                            if (jobs.empty()) return; // stopping, and every job has run
+                            job = move(jobs.front());
+                            jobs.pop_front();
+                        }
+                        job();
+                    }
+                }));
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                lock_guard<mutex> guard(lock);
+                stopping = true;
+            }
+            available.notify_all();
+            for (int t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+        }
+
+        void post(function<void()> job) {
+            {
+                lock_guard<mutex> guard(lock);
+                jobs.push_back(move(job));
+            }
+            available.notify_one();
+        }
+
+        // co_await pool.schedule() carries on with the coroutine on a worker thread
+        auto schedule() {
+            struct Awaiter {
+                ThreadPool* pool;
+                bool await_ready() { return false; }
+                void await_suspend(coroutine_handle<> waiting) { pool->post([waiting]() { waiting.resume(); }); }
+                void await_resume() {}
+            };
+            return Awaiter{ this };
+        }
+};
+
+// a coroutine that starts at once and frees itself when it returns, one per request
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        suspend_never initial_suspend() { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+// routing requests waiting for a search. requests arriving while a batch is queued on the pool join it, so under load
+// the batches grow. each request is answered by the snapshot's hierarchy, except that treeGroup or more requests of a
+// batch with the same snapshot and source share one shortest path tree: on 20000 cities a one-to-all dijkstra takes
+// about 7 ms against 70 us for a hierarchy query, so the tree only pays off for about a hundred targets
+class RouteBatcher {
+    private:
+        struct Request {
+            GraphSnapshot* snapshot;
+            Vertex* from;
+            Vertex* to;
+            Route* result;
+            coroutine_handle<> waiting;
+        };
+
+        ThreadPool* pool;
+        int treeGroup;
+        mutex lock;
+        vector<Request> pending;
+        bool flushQueued;
+
+        // one query object per worker thread, rebuilt when a new snapshot version comes along
+        static HierarchyQuery& queryFor(GraphSnapshot* snapshot) {
+            thread_local unique_ptr<HierarchyQuery> query;
+            thread_local long version = -1;
+            if (query == NULL || version != snapshot->version) {
+                query.reset(new HierarchyQuery(*snapshot->distances));
+                version = snapshot->version;
+            }
+            return *query;
+        }
+
+        void flush() {
+            TRACE_SPAN("route batch");
+            vector<Request> batch;
+            {
+                lock_guard<mutex> guard(lock);
+                batch.swap(pending);
+                flushQueued = false;
+            }
+            sort(batch.begin(), batch.end(), [](const Request& a, const Request& b) {
+                return a.snapshot != b.snapshot ? a.snapshot->version < b.snapshot->version : a.from->id < b.from->id;
+            });
+
+            for (int i = 0; i < batch.size(); ) {
+                int j = i;
+                while (j < batch.size() && batch[j].snapshot == batch[i].snapshot && batch[j].from == batch[i].from) j++;
+                GraphSnapshot* snapshot = batch[i].snapshot;
+                const vector<float>& weights = snapshot->distances->roadWeight; // km
+                if (j - i < treeGroup) {
+                    HierarchyQuery& query = queryFor(snapshot);
+                    for (int k = i; k < j; k++) {
+                        searches++;
+                        vector<Vertex*> path = query.getShortestPath(batch[k].from, batch[k].to);
+                        vector<int> vertices;
+                        for (int v = 0; v < path.size(); v++) vertices.push_back(path[v]->id);
+                        if (!vertices.empty()) *batch[k].result = routeAlong(snapshot->graph, vertices, weights);
+                    }
+                }
+                else {
+                    searches++;
+                    ShortestPathTree tree = Dijkstra::getShortestPathTree(snapshot->graph, batch[i].from, weights);
+                    for (int k = i; k < j; k++) {
+                        int target = batch[k].to->id;
+                        if (!tree.reaches(target)) continue;
+                        vector<int> vertices;
+                        for (int v = target; v != -1; v = tree.parent[v]) vertices.push_back(v);
+                        reverse(vertices.begin(), vertices.end());
+                        *batch[k].result = routeAlong(snapshot->graph, vertices, weights);
+                    }
+                }
+                i = j;
+            }
+
+            for (int i = 0; i < batch.size(); i++) {
+                coroutine_handle<> waiting = batch[i].waiting;
+                pool->post([waiting]() { waiting.resume(); });
+            }
+        }
+
+        void enqueue(const Request& request) {
+            bool post;
+            {
+                lock_guard<mutex> guard(lock);
+                pending.push_back(request);
+                post = !flushQueued;
+                flushQueued = true;
+            }
+            requests++;
+            if (post) pool->post([this]() { flush(); });
+        }
+
+    public:
+        static Route routeAlong(Graph& graph, const vector<int>& vertices, const vector<float>& weights) {
+            vector<int> roads;
+            for (int i = 0; i + 1 < vertices.size(); i++) {
+                roads.push_back(graph.getVertex(vertices[i])->getRoadTo(graph.getVertex(vertices[i + 1]))->id);
+            }
+            return Route(graph, vertices, roads, weights);
+        }
+
+        atomic<long> requests; // routed so far
+        atomic<long> searches; // searches run for them
+
+        RouteBatcher(ThreadPool& pool, int treeGroup = 100) : requests(0), searches(0) {
+            this->pool = &pool;
+            this->treeGroup = max(1, treeGroup);
+            flushQueued = false;
+        }
+
+        // co_await batcher.route(...) suspends until the batch holding the request has been searched. result is left
+        // empty if the cities are not connected, without suspending or searching; the snapshot must stay referenced
+        // until then
+        auto route(GraphSnapshot* snapshot, Vertex* from, Vertex* to, Route& result) {
+            struct Awaiter {
+                RouteBatcher* batcher;
+                Request request;
+                bool await_ready() { // O(1)
+                    return !request.snapshot->components->connected(request.from, request.to);
+                }
+                void await_suspend(coroutine_handle<> waiting) {
+                    request.waiting = waiting;
+                    batcher->enqueue(request);
+                }
+                void await_resume() {}
+            };
+            return Awaiter{ this, { snapshot, from, to, &result, coroutine_handle<>() } };
+        }
+};
+
+// non-interactive front end (--serve). one request per input line, "from,to", answered by one json line in input order;
+// "reload <file>" (.csv, or a binary map) publishes a new map for the lines after it while earlier requests finish on
+// the old one. the reading thread only reads and the writing thread only writes; each request is a coroutine that
+// parses and resolves the names on the pool, waits for its batch to be routed (unless the result cache has the
+// route), and serialises the fares. at most maxInFlight lines are read but not yet written, beyond that reading waits
+class RouteServer {
+    private:
+        SnapshotRegistry* registry;
+        ResultCache* cache; // NULL for none
+        ThreadPool pool;
+        RouteBatcher batcher;
+        counting_semaphore<> slots;
+
+        mutex lock;
+        condition_variable changed;
+        map<long, string> ready; // answered, waiting for an earlier line
+        long inFlight;
+        bool reading;
+
+        static string json(const string& text) {
+            string quoted = "\"";
+            for (int i = 0; i < text.size(); i++) {
+                char c = text[i];
+                if (c == '"' || c == '\\') quoted += '\\';
+                if ((unsigned char)c < 0x20) quoted += ' ';
+                else quoted += c;
+            }
+            return quoted + "\"";
+        }
+
+        static string error(long id, const string& message) {
+            return "{\"id\":" + to_string(id) + ",\"error\":" + json(message) + "}";
+        }
+
+        static string unknownCity(long id, const string& city, CityIndex& names) {
+            ostringstream out;
+            out << "{\"id\":" << id << ",\"error\":\"unknown city\",\"city\":" << json(city) << ",\"suggestions\":[";
+            vector<Vertex*> suggestions = names.suggest(city, 2, 3);
+            for (int i = 0; i < suggestions.size(); i++) out << (i > 0 ? "," : "") << json(suggestions[i]->city);
+            out << "]}";
+            return out.str();
+        }
+
+        static string serialise(long id, long version, Vertex* from, Vertex* to, Route& route) {
+            if (route.path.empty()) {
+                return error(id, "no road connects " + from->city + " and " + to->city);
+            }
+            ostringstream out;
+            out << "{\"id\":" << id << ",\"version\":" << version << ",\"from\":" << json(from->city) << ",\"to\":" << json(to->city)
+                << ",\"km\":" << route.distance << ",\"toll\":" << route.toll << ",\"fares\":{";
+            for (int i = 0; i < vehicle_tiers; i++) out << (i > 0 ? "," : "") << json(vehicle_tier_names[i]) << ":" << route.fares[i];
+            out << "},\"path\":[";
+            for (int i = 0; i < route.path.size(); i++) out << (i > 0 ? "," : "") << json(route.path[i]->city);
+            out << "]}";
+            return out.str();
+        }
+
+        void respond(long id, const string& response) {
+            lock_guard<mutex> guard(lock);
+            ready[id] = response;
+            changed.notify_all();
+        }
+
+        void finished() {
+            lock_guard<mutex> guard(lock);
+            inFlight--;
+            changed.notify_all();
+        }
+
+        // snapshot is the map current when the line was read, so a later reload does not change the answer
+        static Detached handle(RouteServer* server, long id, string line, SnapshotHandle snapshot) {
+            co_await server->pool.schedule();
+            TRACE_SPAN("request");
+            size_t comma = line.find_first_of(",\t");
+            if (comma == string::npos) {
+                server->respond(id, error(id, "expected \"from,to\""));
+            }
+            else {
+                string fromName = trim(line.substr(0, comma)), toName = trim(line.substr(comma + 1));
+                Vertex* from = snapshot->names->find(fromName);
+                Vertex* to = snapshot->names->find(toName);
+                if (from == NULL || to == NULL) {
+                    server->respond(id, unknownCity(id, from == NULL ? fromName : toName, *snapshot->names));
+                }
+                else {
+                    Route route;
+                    vector<int> vertices;
+                    float km;
+                    ResultCache* cache = server->cache;
+                    if (cache != NULL && cache->getPath(snapshot->fingerprint, snapshot->distanceFingerprint, from->id, to->id, vertices, km)) {
+                        server->cacheHits++;
+                        route = RouteBatcher::routeAlong(snapshot->graph, vertices, snapshot->distances->roadWeight);
+                    }
+                    else {
+                        co_await server->batcher.route(&*snapshot, from, to, route);
+                        if (cache != NULL && !route.path.empty()) {
+                            for (int i = 0; i < route.path.size(); i++) vertices.push_back(route.path[i]->id);
+                            cache->putPath(snapshot->fingerprint, snapshot->distanceFingerprint, vertices, route.weight);
+                        }
+                    }
+                    server->respond(id, serialise(id, snapshot->version, from, to, route));
+                }
+            }
+            server->finished();
+        }
+
+        void write(ostream& out) {
+            long next = 0;
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                changed.wait(guard, [&]() { return ready.count(next) > 0 || (!reading && inFlight == 0 && ready.empty()); });
+                if (ready.empty()) return;
+                while (ready.count(next) > 0) {
+                    string response = move(ready[next]);
+                    ready.erase(next++);
+                    guard.unlock();
+                    out << response << '\n';
+                    slots.release(); // the line is out, so a new one may be read
+                    guard.lock();
+                }
+                guard.unlock();
+                out.flush();
+                guard.lock();
+            }
+        }
+
+    public:
+        atomic<long> cacheHits;
+
+        RouteServer(SnapshotRegistry& registry, ResultCache* cache = NULL, int threads = thread::hardware_concurrency(), int maxInFlight = 256)
+            : pool(threads), batcher(pool), slots(max(1, maxInFlight)), cacheHits(0) {
+            this->registry = &registry;
+            this->cache = cache;
+            inFlight = 0;
+            reading = false;
+        }
+
+        // until the input ends and every request has been answered
+        void run(istream& in, ostream& out) {
+            reading = true;
+            thread writer([&]() { write(out); });
+            string line;
+            for (long id = 0; getline(in, line); ) {
+                line = trim(line);
+                if (line.empty() || line[0] == '#') continue;
+                slots.acquire(); // backpressure, every line waiting in ready holds a slot until it is written
+                if (line.compare(0, 7, "reload ") == 0) {
+                    string path = trim(line.substr(7));
+                    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+                    bool loaded = csv ? registry->reloadFromCsv(path) : registry->reloadFromBinary(path);
+                    respond(id, loaded ? "{\"id\":" + to_string(id) + ",\"version\":" + to_string(registry->version()) + "}" : error(id, "could not load " + path));
+                    id++;
+                    continue;
+                }
+                {
+                    lock_guard<mutex> guard(lock);
+                    inFlight++;
+                }
+                handle(this, id++, line, registry->acquire());
+            }
+            {
+                lock_guard<mutex> guard(lock);
+                reading = false;
+                changed.notify_all();
+            }
+            writer.join();
+        }
+
+        long requestCount() {
+            return batcher.requests.load();
+        }
+
+        long searchCount() {
+            return batcher.searches.load();
+        }
+};
+
+#endif
+
+
+///////////////////////////////////////// Self Checks /////////////////////////////////////////
+
+// --check: the incremental and accelerated searches against plain dijkstra or brute force on the map, one line per
+// check. a check that edits roads works on a copy
+
+bool reportCheck(const string& name, int cases, int failures, ostream& out) {
+    out << "  " << name << ", " << cases << " cases: " << (failures == 0 ? "ok" : to_string(failures) + " FAILED") << endl;
+    return failures == 0;
+}
+
+// equal up to float rounding, paths of equal length may sum their roads in another order
+bool sameDistance(float a, float b) {
+    if (a >= infinity || b >= infinity) {
+        return a == b;
+    }
+    return fabs(a - b) <= 1e-4f * max(1.0f, max(a, b));
+}
+
+void copyGraph(Graph& graph, Graph& copy) {
+    for (int i = 0; i < graph.vertexCount(); i++) {
+        Vertex* v = graph.getVertex(i);
+        copy.addVertex(v->city, v->latitude, v->longitude);
+    }
+    for (int i = 0; i < graph.roadCount(); i++) { // in id order, so the copy's road ids match
+        Road* road = graph.getRoad(i);
+        copy.addEdge(road->from->city, road->to->city);
+        copy.getRoad(i)->distance = road->distance;
+        copy.getRoad(i)->toll = road->toll;
+        copy.getRoad(i)->speed = road->speed;
+        copy.getRoad(i)->open = road->open;
+    }
+}
+
+// number of cities for which check(source, tree) fails, tree being dijkstra's shortest path tree from the city under
+// the weights
+template <class Check>
+int failingSources(Graph& graph, const vector<float>& weights, Check check) {
+    int failures = 0;
+    for (int s = 0; s < graph.vertexCount(); s++) {
+        Vertex* source = graph.getVertex(s);
+        ShortestPathTree tree = Dijkstra::getShortestPathTree(graph, source, weights);
+        if (!check(source, tree)) failures++;
+    }
+    return failures;
+}
+
+template <class Check>
+int failingSources(Graph& graph, Check check) {
+    return failingSources(graph, Metrics::distance(graph), check);
+}
+
+// weight of the cities' path along open roads, infinity if two consecutive cities are not joined by one
+float pathWeight(const vector<float>& weights, const vector<Vertex*>& path) {
+    float weight = 0;
+    for (int i = 0; i + 1 < path.size(); i++) {
+        Road* road = path[i]->getRoadTo(path[i + 1]);
+        if (road == NULL || !road->open) {
+            return infinity;
+        }
+        weight += weights[road->id];
+    }
+    return weight;
+}
+
+// every city a cached source, random closures, reopenings and reweights, and every tree against dijkstra after each
+bool checkDynamicShortestPaths(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    DynamicShortestPaths dynamic(graph);
+    for (int i = 0; i < graph.vertexCount(); i++) dynamic.addSource(graph.getVertex(i)->city);
+
+    mt19937 random(5);
+    uniform_real_distribution<float> factor(0.5, 2.0);
+    int failures = 0, edits = 200;
+    for (int edit = 0; edit < edits; edit++) {
+        Road* road = graph.getRoad(random() % graph.roadCount());
+        string city1 = road->from->city, city2 = road->to->city;
+        switch (random() % 3) {
+            case 0: dynamic.closeRoad(city1, city2); break;
+            case 1: dynamic.reopenRoad(city1, city2); break;
+            default: dynamic.reweightRoad(city1, city2, road->distance * factor(random)); break;
+        }
+        failures += failingSources(graph, [&](Vertex* source, ShortestPathTree& tree) {
+            ShortestPathTree* cached = dynamic.getTree(source->city);
+            for (int v = 0; v < graph.vertexCount(); v++) {
+                if (!sameDistance(cached->distance[v], tree.distance[v])) return false;
+            }
+            return true;
+        });
+    }
+    return reportCheck("dynamic shortest paths against dijkstra", edits * graph.vertexCount(), failures, out);
+}
+
+// hierarchy distances and unpacked paths between every pair of cities against dijkstra, for km, minutes and fares
+// customized on one hierarchy. the sources are split over 2, 4 and 8 threads, each with its own query on the shared
+// metric. badin's only road is closed, so it is unconnected
+bool checkContractionHierarchy(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    ContractionHierarchy hierarchy(graph);
+    int n = graph.vertexCount(), cases = 0, failures = 0;
+    for (int metric = 0; metric < 3; metric++) {
+        vector<float> weights = metric == 0 ? Metrics::distance(graph) : metric == 1 ? Metrics::travelTime(graph) : Metrics::fare(graph, 50);
+        CustomizedMetric customized(hierarchy, weights);
+        for (int threads : { 2, 4, 8 }) {
+            vector<float> distances(n * n);
+            vector<vector<Vertex*>> paths(n * n);
+            atomic<int> nextSource(0);
+            vector<thread> workers;
+            for (int w = 0; w < threads; w++) {
+                workers.push_back(thread([&]() {
+                    HierarchyQuery query(customized);
+                    for (int s = nextSource++; s < n; s = nextSource++) {
+                        for (int t = 0; t < n; t++) {
+                            distances[s * n + t] = query.getDistance(graph.getVertex(s), graph.getVertex(t));
+                            paths[s * n + t] = query.getShortestPath(graph.getVertex(s), graph.getVertex(t));
+                        }
+                    }
+                }));
+            }
+            for (int w = 0; w < threads; w++) workers[w].join();
+
+            cases += n;
+            failures += failingSources(graph, weights, [&](Vertex* from, ShortestPathTree& tree) {
+                for (int t = 0; t < n; t++) {
+                    vector<Vertex*>& path = paths[from->id * n + t];
+                    if (!sameDistance(distances[from->id * n + t], tree.distance[t])) return false;
+                    if (tree.distance[t] == infinity) {
+                        if (!path.empty()) return false;
+                    }
+                    else if (path.empty() || path.front() != from || path.back() != graph.getVertex(t)
+                             || !sameDistance(pathWeight(weights, path), tree.distance[t])) return false;
+                }
+                return true;
+            });
+        }
+    }
+    return reportCheck("hierarchy queries on 2, 4 and 8 threads against dijkstra", cases, failures, out);
+}
+
+// true if the destination can be reached from the city without passing a city on the path, O(V+E)
+bool reachesAround(Graph& graph, int city, int target, const vector<bool>& onPath) {
+    vector<bool> seen(onPath);
+    vector<int> stack(1, city);
+    seen[city] = true;
+    while (!stack.empty()) {
+        Vertex* vertex = graph.getVertex(stack.back());
+        stack.pop_back();
+        if (vertex->id == target) return true;
+        for (int i = 0; i < vertex->neighbors.size(); i++) {
+            int next = vertex->neighbors[i]->id;
+            if (vertex->roads[i]->open && !seen[next]) {
+                seen[next] = true;
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+// the first limit simple paths from the city to the destination no heavier than bound, pruned with the distances
+// towards it and with the cities still reachable around the path, so every branch taken ends in a path
+void simplePaths(Graph& graph, const vector<float>& weights, ShortestPathTree& toTarget, int city, float weight, float bound,
+                 int limit, vector<bool>& onPath, vector<float>& found) {
+    if (city == toTarget.source) {
+        found.push_back(weight);
+        return;
+    }
+    onPath[city] = true;
+    Vertex* vertex = graph.getVertex(city);
+    for (int i = 0; i < vertex->neighbors.size() && found.size() < limit; i++) {
+        Road* road = vertex->roads[i];
+        int next = vertex->neighbors[i]->id;
+        float nextWeight = weight + weights[road->id];
+        if (road->open && !onPath[next] && nextWeight + toTarget.distance[next] <= bound
+            && reachesAround(graph, next, toTarget.source, onPath)) {
+            simplePaths(graph, weights, toTarget, next, nextWeight, bound, limit, onPath, found);
+        }
+    }
+    onPath[city] = false;
+}
+
+// a route is loop free, runs along its roads and weighs what they add up to
+bool isSoundRoute(Graph& graph, const vector<float>& weights, Route& route) {
+    set<Vertex*> visited(route.path.begin(), route.path.end());
+    if (visited.size() != route.path.size() || route.roads.size() + 1 != route.path.size()) {
+        return false;
+    }
+    float weight = 0;
+    for (int i = 0; i < route.roads.size(); i++) {
+        Road* road = graph.getRoad(route.roads[i]);
+        if (road->from != route.path[i] && road->to != route.path[i]) return false;
+        if (road->from != route.path[i + 1] && road->to != route.path[i + 1]) return false;
+        weight += weights[road->id];
+    }
+    return sameDistance(weight, route.weight);
+}
+
+// yen's routes towards every city against the k lightest of all simple paths enumerated by brute force, and every
+// route loop free. the tree of the destination is the tree towards it, roads run both ways
+bool checkAlternativeRoutes(Graph& graph, ostream& out) {
+    const int k = 5;
+    vector<float> weights = Metrics::distance(graph);
+    AlternativeRoutes alternatives(graph, weights);
+    int failures = failingSources(graph, [&](Vertex* to, ShortestPathTree& toTarget) {
+        for (int f = 0; f < graph.vertexCount(); f++) {
+            Vertex* from = graph.getVertex(f);
+            vector<Route> routes = alternatives.kShortestPaths(from, to, k);
+            vector<Route> plausible = alternatives.plausibleAlternatives(from, to, 3);
+
+            // with fewer than k routes there must not be a k-th simple path at any weight
+            vector<float> all;
+            vector<bool> onPath(graph.vertexCount(), false);
+            float bound = routes.size() == k ? routes.back().weight * (1 + 1e-4f) : infinity;
+            int limit = routes.size() == k ? graph.vertexCount() * k : k;
+            if (toTarget.reaches(from->id)) simplePaths(graph, weights, toTarget, from->id, 0, bound, limit, onPath, all);
+            sort(all.begin(), all.end());
+
+            if (routes.size() != min((int)all.size(), k)) return false;
+            for (int i = 0; i < routes.size(); i++) {
+                if (!isSoundRoute(graph, weights, routes[i]) || routes[i].path.front() != from || routes[i].path.back() != to
+                    || !sameDistance(routes[i].weight, all[i])) return false;
+            }
+            for (int i = 0; i < plausible.size(); i++) {
+                if (!isSoundRoute(graph, weights, plausible[i])) return false;
+            }
+        }
+        return true;
+    });
+    return reportCheck("alternative routes against all simple paths", graph.vertexCount(), failures, out);
+}
+
+// isochrones of every city for a few budgets, from one reused search and batched on 4 threads, against the cities of
+// its dijkstra tree that are within the budget
+bool checkIsochrones(Graph& graph, ostream& out) {
+    const float budgets[] = { 0, 150, 600, 2000 };
+    const int budgetCount = 4;
+    vector<float> weights = Metrics::distance(graph);
+    IsochroneSearch search(graph, weights); // reused, so its scratch arrays have to be reset after each run
+    vector<Vertex*> origins;
+    for (int i = 0; i < graph.vertexCount(); i++) origins.push_back(graph.getVertex(i));
+    vector<vector<Isochrone>> batched;
+    for (int b = 0; b < budgetCount; b++) batched.push_back(Isochrones::batch(graph, origins, budgets[b], weights, 4));
+
+    int failures = failingSources(graph, [&](Vertex* origin, ShortestPathTree& tree) {
+        for (int b = 0; b < budgetCount; b++) {
+            int inside = 0;
+            for (int v = 0; v < graph.vertexCount(); v++) inside += tree.distance[v] <= budgets[b];
+            Isochrone single = search.within(origin, budgets[b]);
+            for (int pass = 0; pass < 2; pass++) {
+                Isochrone& isochrone = pass == 0 ? single : batched[b][origin->id];
+                if (isochrone.origin != origin || isochrone.reachable.size() != inside) return false;
+                for (int i = 0; i < isochrone.reachable.size(); i++) {
+                    Vertex* city = isochrone.reachable[i].first;
+                    float distance = isochrone.reachable[i].second;
+                    if (tree.distance[city->id] > budgets[b] || !sameDistance(distance, tree.distance[city->id])
+                        || (i > 0 && distance < isochrone.reachable[i - 1].second)) return false;
+                }
+            }
+        }
+        return true;
+    });
+    return reportCheck("isochrones against dijkstra", graph.vertexCount(), failures, out);
+}
+
+// overlay distances and unpacked paths between every pair of cities against dijkstra, for km and again after
+// customizing the same overlay for fares. badin's only road is closed, so it is unconnected
+bool checkOverlay(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    MultiLevelPartition partition(graph, { 4, 16 });
+    OverlayGraph overlay(graph, partition);
+    OverlayQuery query(overlay);
+    int failures = 0;
+    for (int metric = 0; metric < 2; metric++) {
+        vector<float> weights = metric == 0 ? Metrics::distance(graph) : Metrics::fare(graph, 50);
+        overlay.customize(weights);
+        failures += failingSources(graph, weights, [&](Vertex* from, ShortestPathTree& tree) {
+            for (int t = 0; t < graph.vertexCount(); t++) {
+                Vertex* to = graph.getVertex(t);
+                vector<Vertex*> path = query.getShortestPath(from, to);
+                if (!sameDistance(query.getDistance(from, to), tree.distance[t])) return false;
+                if (tree.distance[t] == infinity) {
+                    if (!path.empty()) return false;
+                }
+                else if (path.empty() || path.front() != from || path.back() != to
+                         || !sameDistance(pathWeight(weights, path), tree.distance[t])) return false;
+            }
+            return true;
+        });
+    }
+    return reportCheck("overlay queries against dijkstra", 2 * graph.vertexCount(), failures, out);
+}
 
-                        // calculate distance between the current and adjacent vertices using haversine through graph class
-                        float edgeDistance = currentVertex->calculateDistance(adjacentVertex);
-                        evaluateDistanceAndPath(adjacentVertex, currentVertex, edgeDistance);
-                        if (!adjacentVertex->settled) {
-                            unsettledVertices.insert(adjacentVertex);
-                            adjacentVertex->settled = true;
+// delta stepping trees from every city on 2, 4 and 8 threads against dijkstra, whose distances they must match
+// exactly, for km and fares with a small, the average and a huge delta; then from a few cities of a random 5000 city
+// graph, where the threads contend more. every parent must lie on a shortest path. badin's only road is closed
+bool checkDeltaStepping(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    Graph* random = syntheticGraph(5000, 3, 42);
+    int cases = 0, failures = 0;
+    for (int metric = 0; metric < 3; metric++) {
+        Graph& searched = metric < 2 ? graph : *random;
+        vector<float> weights = metric == 1 ? Metrics::fare(searched, 50) : Metrics::distance(searched);
+        CompactGraph compact(searched, weights);
+        float average = compact.averageArcWeight();
+        int sources = metric < 2 ? searched.vertexCount() : 8;
+        for (float delta : { average / 8, average, 1e9f }) {
+            for (int threads : { 2, 4, 8 }) {
+                DeltaStepping search(compact, delta, threads);
+                for (int s = 0; s < sources; s++) {
+                    int source = s * searched.vertexCount() / sources;
+                    ShortestPathTree tree = search.getShortestPathTree(source);
+                    ShortestPathTree reference = Dijkstra::getShortestPathTree(searched, searched.getVertex(source), weights);
+                    bool same = tree.source == source && tree.distance == reference.distance;
+                    for (int v = 0; same && v < searched.vertexCount(); v++) {
+                        if (v == source || tree.distance[v] == infinity) {
+                            same = tree.parent[v] == -1;
+                            continue;
                         }
+                        Road* road = tree.parentRoad[v] == -1 ? NULL : searched.getRoad(tree.parentRoad[v]);
+                        same = road != NULL && tree.distance[tree.parent[v]] + weights[road->id] == tree.distance[v];
                     }
+                    cases++;
+                    if (!same) failures++;
                 }
             }
         }
+    }
+    delete random;
 
-        static vector<Vertex*> getPath(Vertex* destination) { // O(V)
-            vector<Vertex*> paths = destination->shortestPath;
-            paths.push_back(destination);
-            return paths;
-        }
+    CompactGraph compact(graph, Metrics::distance(graph));
+    DeltaStepping unusable(compact, 0, 2);
+    cases++;
+    if (unusable.getShortestPathTree(0).source != -1) failures++;
+    return reportCheck("delta stepping on 2, 4 and 8 threads against dijkstra", cases, failures, out);
+}
 
-        static void evaluateDistanceAndPath(Vertex* adjacentVertex, Vertex* sourceVertex, float edgeDistance) { // O(V)
-            float newDistance = sourceVertex->shortestDistance + edgeDistance;
+// component labels against the cities each dijkstra tree reaches, on the map as it is, with badin's only road closed
+// and with a growing number of random roads closed. the component count must equal the number of cities that are
+// the lowest id they reach
+bool checkConnectedComponents(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    mt19937 random(4);
+    int cases = 0, failures = 0;
+    for (int round = 0; round < 6; round++) {
+        if (round == 1) graph.getRoad("Badin", "Thatta")->open = false;
+        for (int i = 0; round > 1 && i < 8; i++) graph.getRoad(random() % graph.roadCount())->open = false;
+
+        ConnectedComponents components(graph);
+        int lowest = 0;
+        cases += graph.vertexCount() + 1;
+        failures += failingSources(graph, [&](Vertex* from, ShortestPathTree& tree) {
+            int reached = 0;
+            for (int t = 0; t < graph.vertexCount(); t++) {
+                if (components.connected(from, graph.getVertex(t)) != tree.reaches(t)) return false;
+                if (tree.reaches(t)) {
+                    if (reached == 0 && t == from->id) lowest++;
+                    reached++;
+                }
+            }
+            return components.componentSize(components.componentOf(from)) == reached;
+        });
+        if (components.componentCount() != lowest) failures++;
+    }
+    return reportCheck("component labels against dijkstra", cases, failures, out);
+}
 
-            if (newDistance < adjacentVertex->shortestDistance) {
-                adjacentVertex->shortestDistance = newDistance;
-                adjacentVertex->shortestPath = sourceVertex->shortestPath;
-                adjacentVertex->shortestPath.push_back(sourceVertex);
+// every city's name found in other case and spacing, every prefix of every name autocompleted, and typos of every
+// name (one character dropped, one replaced, one added) suggested within 2 edits, each against a scan over all the
+// normalized names
+bool checkCityIndex(Graph& graph, ostream& out) {
+    CityIndex index(graph);
+    int n = graph.vertexCount();
+    vector<pair<string, int>> names; // (normalized name, vertex id), in autocomplete order
+    for (int i = 0; i < n; i++) names.push_back(make_pair(CityIndex::normalize(graph.getVertex(i)->city), i));
+    sort(names.begin(), names.end());
+
+    auto edits = [](const string& a, const string& b) {
+        vector<int> row(b.size() + 1);
+        for (int j = 0; j <= b.size(); j++) row[j] = j;
+        for (int i = 1; i <= a.size(); i++) {
+            int diagonal = row[0];
+            row[0] = i;
+            for (int j = 1; j <= b.size(); j++) {
+                int above = row[j];
+                row[j] = min(diagonal + (a[i - 1] == b[j - 1] ? 0 : 1), min(row[j] + 1, row[j - 1] + 1));
+                diagonal = above;
             }
         }
-
-    public:
-        static vector<Vertex*> getShortestPath(Vertex* from, Vertex* to) { // O(E*logV)
-            calculateShortestPath(from);
-            return getPath(to);
+        return row[b.size()];
+    };
+
+    int cases = 0, failures = 0;
+    for (int i = 0; i < n; i++) {
+        string name = graph.getVertex(i)->city, key = CityIndex::normalize(name);
+        bool ok = true;
+
+        string shouted = "  ";
+        for (int c = 0; c < name.size(); c++) shouted += name[c] == ' ' ? string("   ") : string(1, (char)toupper((unsigned char)name[c]));
+        Vertex* found = index.find(shouted);
+        ok = found != NULL && CityIndex::normalize(found->city) == key && index.find(name + "x") == NULL;
+
+        for (int length = 1; ok && length <= key.size(); length++) {
+            string prefix = key.substr(0, length);
+            vector<Vertex*> matches = index.autocomplete(prefix, n);
+            vector<Vertex*> expected;
+            for (int k = 0; k < n; k++) {
+                if (names[k].first.compare(0, length, prefix) == 0) expected.push_back(graph.getVertex(names[k].second));
+            }
+            ok = matches == expected && index.autocomplete(prefix, 1).size() == 1;
         }
-};
 
+        vector<string> typos = { key.substr(1), key.substr(0, key.size() / 2) + "q" + key.substr(key.size() / 2 + 1),
+            key.substr(0, key.size() / 2) + "z" + key.substr(key.size() / 2) };
+        for (int t = 0; ok && t < typos.size(); t++) {
+            vector<Vertex*> suggestions = index.suggest(typos[t], 2, n);
+            set<int> expected, suggested;
+            for (int k = 0; k < n; k++) {
+                if (edits(typos[t], names[k].first) <= 2) expected.insert(names[k].second);
+            }
+            for (int k = 0; ok && k < suggestions.size(); k++) {
+                suggested.insert(suggestions[k]->id);
+                int distance = edits(typos[t], CityIndex::normalize(suggestions[k]->city));
+                ok = k == 0 || distance >= edits(typos[t], CityIndex::normalize(suggestions[k - 1]->city)); // closest first
+            }
+            ok = ok && suggested == expected && suggested.size() == suggestions.size() && suggested.count(i) == 1;
+        }
+        cases++;
+        if (!ok) failures++;
+    }
+    return reportCheck("city name index against a scan of all names", cases, failures, out);
+}
 
-///////////////////////////////////////// Passenger /////////////////////////////////////////
+// open trips, round trips and trips with a fixed last stop from every city through random stops, against every
+// visiting order. badin's only road is closed, so the trips through it must not be found
+bool checkTripPlanner(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    vector<float> weights = Metrics::distance(graph);
+    TripPlanner planner(graph, weights);
+    mt19937 random(8);
+    int failures = failingSources(graph, weights, [&](Vertex* start, ShortestPathTree& tree) {
+        for (int kind = 0; kind < 3; kind++) {
+            vector<Vertex*> stops(1, start);
+            vector<bool> picked(graph.vertexCount(), false);
+            picked[start->id] = true;
+            for (int size = 2 + random() % 7; stops.size() < size; ) {
+                int city = random() % graph.vertexCount();
+                if (!picked[city]) stops.push_back(graph.getVertex(city));
+                picked[city] = true;
+            }
+            bool roundTrip = kind == 1, keepLastStop = kind == 2;
+            Trip trip = planner.plan(stops, roundTrip, keepLastStop);
+
+            // stop positions 1 .. n-1 in every order, the fixed last stop stays last
+            vector<vector<float>> matrix = planner.distanceMatrix(stops);
+            int n = stops.size();
+            vector<int> order;
+            for (int i = 1; i < n; i++) order.push_back(i);
+            float best = infinity;
+            do {
+                if (keepLastStop && order.back() != n - 1) continue;
+                float total = matrix[0][order[0]];
+                for (int i = 0; i + 1 < order.size(); i++) total += matrix[order[i]][order[i + 1]];
+                if (roundTrip) total += matrix[order.back()][0];
+                best = min(best, total);
+            } while (next_permutation(order.begin(), order.end()));
+
+            if (best >= infinity) {
+                if (trip.found()) return false;
+                continue;
+            }
+            set<Vertex*> visited(trip.stops.begin(), trip.stops.end());
+            bool sound = trip.found() && visited.size() == n && trip.stops.size() == n + (roundTrip ? 1 : 0) && trip.stops[0] == start
+                && trip.route.path.front() == start && trip.route.path.back() == trip.stops.back()
+                && (!keepLastStop || trip.stops.back() == stops[n - 1]) && (!roundTrip || trip.stops.back() == start)
+                && sameDistance(trip.route.weight, best) && sameDistance(pathWeight(weights, trip.route.path), best);
+            if (!sound) return false;
+        }
+        return true;
+    });
+    return reportCheck("trip planner against every visiting order", graph.vertexCount(), failures, out);
+}
 
-class Passenger {
-    public:
-        int ID;
-        string name;
-        char passenger_type;
+// the pareto front between every pair of cities, searched without label limits, against dijkstra for km, minutes and
+// the fare of every tier, with random tolls and speeds: it has to hold the shortest, the fastest and each tier's
+// cheapest route, and no route may beat another on distance, tolls and time at once
+bool checkParetoRoutes(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    mt19937 random(6);
+    uniform_real_distribution<float> toll(0, 500), speed(40, 120);
+    for (int i = 0; i < graph.roadCount(); i++) {
+        if (random() % 4 == 0) graph.getRoad(i)->toll = toll(random);
+        graph.getRoad(i)->speed = speed(random);
+    }
+    vector<float> minutes = Metrics::travelTime(graph);
+    vector<vector<float>> fares;
+    for (int tier = 0; tier < vehicle_tiers; tier++) fares.push_back(Metrics::fare(graph, vehicle_tier_rates[tier]));
+    ParetoRoutes pareto(graph, INT_MAX);
+
+    int failures = failingSources(graph, [&](Vertex* from, ShortestPathTree& shortest) {
+        ShortestPathTree fastest = Dijkstra::getShortestPathTree(graph, from, minutes);
+        vector<ShortestPathTree> cheapest;
+        for (int tier = 0; tier < vehicle_tiers; tier++) cheapest.push_back(Dijkstra::getShortestPathTree(graph, from, fares[tier]));
+
+        for (int t = 0; t < graph.vertexCount(); t++) {
+            Vertex* to = graph.getVertex(t);
+            vector<Route> routes = pareto.between(from, to);
+            if (routes.empty() != (shortest.distance[t] >= infinity)) return false;
+            if (routes.empty()) continue;
+
+            bool hasShortest = false, hasFastest = false;
+            for (int i = 0; i < routes.size(); i++) {
+                hasShortest = hasShortest || sameDistance(routes[i].distance, shortest.distance[t]);
+                hasFastest = hasFastest || sameDistance(routes[i].weight, fastest.distance[t]);
+                if (!isSoundRoute(graph, minutes, routes[i]) || routes[i].path.front() != from || routes[i].path.back() != to) return false;
+                for (int j = 0; j < routes.size(); j++) {
+                    if (j != i && routes[j].distance <= routes[i].distance && routes[j].toll <= routes[i].toll
+                        && routes[j].weight <= routes[i].weight) return false;
+                }
+            }
+            if (!hasShortest || !hasFastest) return false;
+            for (int tier = 0; tier < vehicle_tiers; tier++) {
+                if (!sameDistance(routes[ParetoRoutes::cheapest(routes, tier)].fares[tier], cheapest[tier].distance[t])) return false;
+            }
+        }
+        return true;
+    });
+    return reportCheck("pareto routes against dijkstra", graph.vertexCount(), failures, out);
+}
 
-        Passenger()
-        {
-            ID = 0;
-            name = "";
-            passenger_type = '\0';
+// many to one distances, closest source and paths towards every city against a dijkstra from it (roads are
+// undirected, so that is the search on the reversed graph), and the many to many table of all cities on 4 threads
+// against the same trees. badin's only road is closed, so not every source gets there
+bool checkBatchQueries(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    vector<float> weights = Metrics::distance(graph);
+    ManyToOne batch(graph, weights);
+    ContractionHierarchy hierarchy(graph);
+    CustomizedMetric metric(hierarchy, weights);
+    vector<Vertex*> cities;
+    for (int i = 0; i < graph.vertexCount(); i++) cities.push_back(graph.getVertex(i));
+    vector<vector<float>> table = ManyToMany(metric).distances(cities, cities, 4);
+    mt19937 random(2);
+
+    int failures = failingSources(graph, weights, [&](Vertex* target, ShortestPathTree& tree) {
+        for (int v = 0; v < graph.vertexCount(); v++) {
+            if (!sameDistance(table[v][target->id], tree.distance[v])) return false;
         }
 
-        Passenger(int ID, string name, char passenger_type) {
-            this->ID = ID;
-            this->name = name;
-            this->passenger_type = passenger_type;
+        vector<Vertex*> sources;
+        for (int size = 1 + random() % 20; sources.size() < size; ) {
+            sources.push_back(graph.getVertex(random() % graph.vertexCount())); // repeats allowed
         }
+        int closest = batch.closest(sources, target);
+        float nearest = infinity;
+        for (int i = 0; i < sources.size(); i++) nearest = min(nearest, tree.distance[sources[i]->id]);
+        if (closest == -1 ? nearest < infinity : !sameDistance(tree.distance[sources[closest]->id], nearest)) return false;
+
+        vector<float> distances = batch.distancesTo(sources, target);
+        for (int i = 0; i < sources.size(); i++) {
+            if (!sameDistance(distances[i], tree.distance[sources[i]->id])) return false;
+            vector<Vertex*> path = batch.pathFrom(sources[i]);
+            if (distances[i] < infinity && (path.front() != sources[i] || path.back() != target
+                || !sameDistance(pathWeight(weights, path), distances[i]))) return false;
+        }
+        return true;
+    });
+    return reportCheck("many to one and many to many against dijkstra", graph.vertexCount(), failures, out);
+}
 
-        void display_details() {
-            string category;
+// hub label distances between every pair of cities against dijkstra, for km and for fares. badin's only road is
+// closed, so its pairs must come out as infinity
+bool checkHubLabels(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    ContractionHierarchy hierarchy(graph);
+    int failures = 0;
+    for (int metric = 0; metric < 2; metric++) {
+        vector<float> weights = metric == 0 ? Metrics::distance(graph) : Metrics::fare(graph, 50);
+        HubLabels labels(graph, weights, hierarchy);
+        failures += failingSources(graph, weights, [&](Vertex* from, ShortestPathTree& tree) {
+            for (int t = 0; t < graph.vertexCount(); t++) {
+                if (!sameDistance(labels.getDistance(from, graph.getVertex(t)), tree.distance[t])) return false;
+            }
+            return true;
+        });
+    }
+    return reportCheck("hub labels against dijkstra", 2 * graph.vertexCount(), failures, out);
+}
 
-            cout << "Passenger ID = " << ID << endl;
-            cout << "Passenger name = " << name << endl;
+// a file in the system's temporary directory for a check to write, removed by the check
+string checkFilePath(const string& name) {
+    return (filesystem::temp_directory_path() / ("fast-explorer-check-" + name)).string();
+}
 
-            if (passenger_type == 'A' || passenger_type == 'a') {
-                category = "Adult";
+// every city's shortest paths put into a new cache file, closed, reopened and read back against dijkstra. a second
+// cache on the same file while the first is open, a cache for another graph and a file that is not a cache are all
+// checked too
+bool checkResultCache(Graph& graph, ostream& out) {
+    string path = checkFilePath("cache.bin");
+    filesystem::remove(path);
+    vector<float> weights = Metrics::distance(graph);
+    unsigned long long fingerprint = ResultCache::fingerprint(graph), metric = ResultCache::fingerprint(weights);
+    int cases = 0, failures = 0;
+
+    ResultCache cache;
+    cases++;
+    if (!cache.open(path, fingerprint)) failures++;
+    failingSources(graph, weights, [&](Vertex* from, ShortestPathTree& tree) {
+        for (int t = 0; t < graph.vertexCount(); t++) {
+            if (!tree.reaches(t)) continue;
+            vector<int> vertices;
+            for (int v = t; v != -1; v = tree.parent[v]) vertices.push_back(v);
+            reverse(vertices.begin(), vertices.end());
+            cache.putPath(fingerprint, metric, vertices, tree.distance[t]);
+        }
+        return true;
+    });
+    int stored = cache.size();
+    cache.close();
+
+    cases++;
+    if (!cache.open(path, fingerprint) || cache.size() != stored) failures++;
+    failures += failingSources(graph, weights, [&](Vertex* from, ShortestPathTree& tree) {
+        cases++;
+        for (int t = 0; t < graph.vertexCount(); t++) {
+            vector<int> vertices;
+            float distance;
+            if (!cache.getPath(fingerprint, metric, from->id, t, vertices, distance)) {
+                if (tree.reaches(t)) return false;
+                continue;
             }
-            else if (passenger_type == 'S' || passenger_type == 's') {
-                category = "Student";
+            if (vertices.front() != from->id || vertices.back() != t || !sameDistance(distance, tree.distance[t])) return false;
+            float weight = 0;
+            for (int i = 0; i + 1 < vertices.size(); i++) {
+                Road* road = graph.getVertex(vertices[i])->getRoadTo(graph.getVertex(vertices[i + 1]));
+                if (road == NULL) return false;
+                weight += weights[road->id];
             }
-            else if (passenger_type == 'E' || passenger_type == 'e') {
-                category = "Elderly";
+            if (!sameDistance(weight, distance)) return false;
+        }
+        return true;
+    });
+
+    ResultCache second;
+    cases++;
+    if (second.open(path, fingerprint)) failures++; // locked by the first
+    cache.close();
+    cases++;
+    if (!second.open(path, fingerprint + 1) || second.size() != 0) failures++; // another graph empties it
+    second.close();
+
+    ofstream(path, ios::binary) << "not a cache";
+    cases++;
+    if (second.open(path, fingerprint) || filesystem::file_size(path) != 11) failures++;
+    filesystem::remove(path);
+    return reportCheck("result cache round trip", cases, failures, out);
+}
+
+// handles held across publishes keep their version alive and reclaim() frees each old version once its last handle
+// is gone; then 4 threads publishing while 2 others acquire, every version must be handed out once and no reader may
+// see the version go back
+bool checkSnapshotRegistry(ostream& out) {
+    int cases = 0, failures = 0;
+    SnapshotRegistry registry(new GraphSnapshot(1)); // empty maps, publishing does not look into them
+    {
+        SnapshotHandle first = registry.acquire();
+        cases++;
+        if (registry.publish(new GraphSnapshot(0)) != 2 || first->version != 1 || registry.retiredCount() != 1) failures++;
+        {
+            SnapshotHandle second = registry.acquire();
+            cases++;
+            if (second->version != 2 || registry.publish(new GraphSnapshot(0)) != 3 || registry.retiredCount() != 2) failures++;
+        }
+        registry.reclaim();
+        cases++;
+        if (registry.retiredCount() != 1 || first->version != 1 || registry.version() != 3) failures++;
+    }
+    registry.reclaim();
+    cases++;
+    if (registry.retiredCount() != 0) failures++;
+
+    const int publishers = 4, publishes = 50;
+    vector<long> versions;
+    mutex lock;
+    atomic<bool> publishing(true);
+    atomic<int> backwards(0);
+    vector<thread> readers, writers;
+    for (int r = 0; r < 2; r++) {
+        readers.push_back(thread([&]() {
+            for (long last = 0; publishing.load(); ) {
+                SnapshotHandle handle = registry.acquire();
+                if (handle->version < last) backwards++;
+                last = handle->version;
             }
-            else {
-                category = "Default Adult";
+        }));
+    }
+    for (int p = 0; p < publishers; p++) {
+        writers.push_back(thread([&]() {
+            for (int i = 0; i < publishes; i++) {
+                long version = registry.publish(new GraphSnapshot(0));
+                lock_guard<mutex> guard(lock);
+                versions.push_back(version);
             }
-            cout << "Passenger category = " << category << endl;
-            
-        }
+        }));
+    }
+    for (int p = 0; p < publishers; p++) writers[p].join();
+    publishing.store(false);
+    for (int r = 0; r < readers.size(); r++) readers[r].join();
+    registry.reclaim();
+
+    sort(versions.begin(), versions.end());
+    bool numbered = versions.size() == publishers * publishes && registry.version() == 3 + publishers * publishes;
+    for (int i = 0; numbered && i < versions.size(); i++) numbered = versions[i] == 4 + i;
+    cases++;
+    if (!numbered || backwards.load() > 0 || registry.retiredCount() != 0) failures++;
+    return reportCheck("snapshot acquire, publish and reclaim", cases, failures, out);
+}
 
-        virtual void cost_cal(float distance, int cost_per_KM) = 0;
-};
+// a small extract written to a file and imported: way 10 (primary, maxspeed "50") runs 1-2-3, way 11 (residential)
+// 3-4 is filtered out, way 12 (secondary, "30 mph") runs 3-7 and way 13 (tertiary, no maxspeed) runs 2-6-9-5 with
+// node 9 outside the extract. names carry entities and a '>' inside quotes, the reader must decode the one and step
+// over the other
+bool checkOsmImport(ostream& out) {
+    int cases = 0, failures = 0;
+    istringstream tag("<tag k=\"name\" v=\"Rawalpindi &amp; Islamabad &lt;twin&gt; &quot;cities&quot;\"/>");
+    OsmXmlReader reader(tag);
+    const string* name = reader.next() ? reader.attribute("v") : NULL;
+    cases++;
+    if (name == NULL || *name != "Rawalpindi & Islamabad <twin> \"cities\"") failures++;
+
+    string path = checkFilePath("fixture.osm");
+    ofstream(path, ios::binary) <<
+        "<?xml version='1.0' encoding='UTF-8'?>\n"
+        "<osm version=\"0.6\">\n"
+        " <!-- clipped at the border > node 9 is missing -->\n"
+        " <node id=\"1\" lat=\"31.50\" lon=\"74.30\"/>\n"
+        " <node id=\"2\" lat=\"31.51\" lon=\"74.31\"><tag k=\"name\" v=\"Chowk &amp; Bazaar\"/></node>\n"
+        " <node id=\"3\" lat=\"31.52\" lon=\"74.32\"/>\n"
+        " <node id=\"4\" lat=\"31.53\" lon=\"74.33\"/>\n"
+        " <node id=\"5\" lat=\"31.56\" lon=\"74.36\"/>\n"
+        " <node id=\"6\" lat=\"31.54\" lon=\"74.34\"/>\n"
+        " <node id=\"7\" lat=\"31.55\" lon=\"74.30\"/>\n"
+        " <way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/>"
+        "<tag k=\"name\" v=\"Mall Road > Canal\"/><tag k=\"highway\" v=\"primary\"/><tag k=\"maxspeed\" v=\"50\"/></way>\n"
+        " <way id=\"11\"><nd ref=\"3\"/><nd ref=\"4\"/><tag k=\"highway\" v=\"residential\"/></way>\n"
+        " <way id=\"12\"><nd ref=\"3\"/><nd ref=\"7\"/>"
+        "<tag k=\"highway\" v=\"secondary\"/><tag k=\"maxspeed\" v=\"30 mph\"/></way>\n"
+        " <way id=\"13\"><nd ref=\"2\"/><nd ref=\"6\"/><nd ref=\"9\"/><nd ref=\"5\"/>"
+        "<tag k='name' v='Ring &quot;Road&quot;'/><tag k=\"highway\" v=\"tertiary\"/></way>\n"
+        "</osm>\n";
+
+    LinkedList cities;
+    Graph graph;
+    OsmImporter importer;
+    cases++;
+    if (!importer.import(path, cities, graph) || importer.nodeCount != 7 || importer.wayCount != 4) failures++;
+    filesystem::remove(path);
+
+    // routing nodes 1, 2, 3, 5, 6 and 7, node 4 is only on the residential way
+    cases++;
+    if (graph.vertexCount() != 6 || graph.getVertex("osm:4") != NULL || graph.getVertex("osm:5") == NULL) failures++;
+
+    // the expected roads, with their speeds; 6-5 crosses the missing node and must not be made
+    const char* roads[][2] = { { "osm:1", "osm:2" }, { "osm:2", "osm:3" }, { "osm:3", "osm:7" }, { "osm:2", "osm:6" } };
+    float speeds[] = { 50, 50, 30 * 1.609f, OsmImporter::defaultSpeed("tertiary") };
+    for (int r = 0; r < 4; r++) {
+        cases++;
+        Road* road = graph.getVertex(roads[r][0]) != NULL && graph.getVertex(roads[r][1]) != NULL
+            ? graph.getRoad(roads[r][0], roads[r][1]) : NULL;
+        if (road == NULL || !sameDistance(road->speed, speeds[r])
+            || !sameDistance(road->distance, road->from->calculateDistance(road->to))) failures++;
+    }
+    cases++;
+    if (graph.roadCount() != 4) failures++;
+    return reportCheck("osm import of a clipped extract", cases, failures, out);
+}
 
-class Student : public Passenger {
-    public:
-        Student(int ID, string name, char passenger_type) {
-            this->ID = ID;
-            this->name = name;
-            this->passenger_type = passenger_type;
-        }
+#ifdef FAST_EXPLORER_ASYNC
 
-        void cost_cal(float distance, int cost_per_KM) override {
-            float cost = distance * cost_per_KM;
-            cout << "Price before student discount = Rs. " << cost << endl;
-            cost = cost - (cost * 0.5);
-            cout << "Total cost after student discount (50 %) = Rs. " << cost << endl;
-        }
-};
+// one request of checkRouteBatcher, done is released once it has been answered
+Detached routeRequest(RouteBatcher* batcher, GraphSnapshot* snapshot, Vertex* from, Vertex* to, Route* result, counting_semaphore<>* done) {
+    co_await batcher->route(snapshot, from, to, *result);
+    done->release();
+}
 
-class Adult : public Passenger {
-    public:
-        Adult(int ID, string name, char passenger_type) {
-            this->ID = ID;
-            this->name = name;
-            this->passenger_type = passenger_type;
+// every pair of cities routed in one batch, answered once by hierarchy queries and once by shared trees (treeGroup 1),
+// against a dijkstra per source. the pool's only thread is held until every request has joined the batch. badin's
+// only road is closed, so its requests are answered without a search
+bool checkRouteBatcher(Graph& map, ostream& out) {
+    Graph graph;
+    copyGraph(map, graph);
+    graph.getRoad("Badin", "Thatta")->open = false;
+    LinkedList cities; // names only, routing does not read them
+    GraphSnapshot* snapshot = GraphSnapshot::fromGraph(cities, graph, 1);
+    Graph& routed = snapshot->graph;
+    int n = routed.vertexCount();
+
+    int failures = 0;
+    for (int treeGroup : { INT_MAX, 1 }) {
+        vector<Route> results(n * n);
+        {
+            ThreadPool pool(1);
+            RouteBatcher batcher(pool, treeGroup);
+            counting_semaphore<> gate(0), done(0);
+            pool.post([&]() { gate.acquire(); });
+            for (int i = 0; i < n * n; i++) {
+                routeRequest(&batcher, snapshot, routed.getVertex(i / n), routed.getVertex(i % n), &results[i], &done);
+            }
+            gate.release();
+            for (int i = 0; i < n * n; i++) done.acquire();
         }
 
-        void cost_cal(float distance, int cost_per_KM) override {
-            float cost = distance * cost_per_KM;
-            cout << "No discount applicable :(" << endl;
-            cout << "Total cost = Rs. " << cost << endl;
-        }
-};
+        vector<float> weights = snapshot->distances->roadWeight;
+        failures += failingSources(routed, weights, [&](Vertex* from, ShortestPathTree& tree) {
+            for (int t = 0; t < n; t++) {
+                vector<Vertex*>& path = results[from->id * n + t].path;
+                if (tree.distance[t] == infinity) {
+                    if (!path.empty()) return false;
+                }
+                else if (path.empty() || path.front() != from || path.back() != routed.getVertex(t)
+                         || !sameDistance(pathWeight(weights, path), tree.distance[t])) return false;
+            }
+            return true;
+        });
+    }
+    delete snapshot;
+    return reportCheck("batched routes against dijkstra", 2 * graph.vertexCount(), failures, out);
+}
 
-class Elderly : public Passenger {
-    public:
-        Elderly(int ID, string name, char passenger_type) {
-            this->ID = ID;
-            this->name = name;
-            this->passenger_type = passenger_type;
-        }
+#endif
+
+// true if every check passed
+bool runChecks(Graph& graph) {
+    bool passed = true;
+    cout << "self checks, " << graph.vertexCount() << " cities" << endl;
+    passed = checkDynamicShortestPaths(graph, cout) && passed;
+    passed = checkContractionHierarchy(graph, cout) && passed;
+    passed = checkAlternativeRoutes(graph, cout) && passed;
+    passed = checkIsochrones(graph, cout) && passed;
+    passed = checkOverlay(graph, cout) && passed;
+    passed = checkDeltaStepping(graph, cout) && passed;
+    passed = checkConnectedComponents(graph, cout) && passed;
+    passed = checkCityIndex(graph, cout) && passed;
+    passed = checkTripPlanner(graph, cout) && passed;
+    passed = checkParetoRoutes(graph, cout) && passed;
+    passed = checkBatchQueries(graph, cout) && passed;
+    passed = checkHubLabels(graph, cout) && passed;
+    passed = checkResultCache(graph, cout) && passed;
+    passed = checkSnapshotRegistry(cout) && passed;
+    passed = checkOsmImport(cout) && passed;
+#ifdef FAST_EXPLORER_ASYNC
+    passed = checkRouteBatcher(graph, cout) && passed;
+#endif
+    return passed;
+}
 
-        void cost_cal(float distance, int cost_per_KM) override {
-            float cost = distance * cost_per_KM;
-            cout << "Price before elderly discount = Rs. " << cost << endl;
-            cost = cost - (cost * 0.8);
-            cout << "Total cost after elderly discount (80 %) = Rs. " << cost << endl;
-        }
-};
 
-class Vehicle {
-    protected:
-        int cost_per_KM;
+///////////////////////////////////////// Main /////////////////////////////////////////
 
-    public:
-        Vehicle() {
-            cost_per_KM = 0;
-        }
-        Vehicle(int cost) {
-            cost_per_KM = cost;
-        }
-        int get_cost_per_KM() {
-            return cost_per_KM; 
+// reads a whole line so multi word names work, accepts unique prefixes and offers suggestions for typos
+// NULL once the input has ended
+Vertex* askCity(CityIndex& cities, string prompt) {
+    while (true) {
+        string name;
+        cout << prompt;
+        if (!getline(cin >> ws, name)) {
+            return NULL;
         }
-};
 
-class Mini : public Vehicle {
-    public:
-        Mini() {
-            cost_per_KM = 20;
-            cout << "Mini Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        Vertex* city = cities.find(name);
+        if (city != NULL) {
+            return city;
         }
-};
 
-class Standard : public Vehicle {
-    public:
-        Standard() {
-            cost_per_KM = 50;
-            cout << "Standard Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        vector<Vertex*> matches = cities.autocomplete(name, 5);
+        if (matches.size() == 1) {
+            return matches[0];
         }
-};
-
-class Luxury : public Vehicle {
-    public:
-        Luxury() {
-            cost_per_KM = 100;
-            cout << "Luxury Vehicle: Cost per KM = Rs." << cost_per_KM << endl;
+        if (matches.empty()) {
+            matches = cities.suggest(name, 2, 5);
         }
-};
 
+        if (matches.empty()) {
+            cout << "City not found, try again." << endl;
+        }
+        else {
+            cout << "City not found. Did you mean:";
+            for (int i = 0; i < matches.size(); i++) {
+                cout << (i == 0 ? " " : ", ") << matches[i]->city;
+            }
+            cout << "?" << endl;
+        }
+    }
+}
 
-///////////////////////////////////////// Main /////////////////////////////////////////
-
-int main() {
+int main(int argc, char* argv[]) {
+
+    bool bench = false, check = false;
+    string tracePath; // --trace=file.json, chrome trace of the whole run when built with FAST_EXPLORER_TRACE
+    string osmPath;   // --import-osm=extract.osm, converted to the binary map file given by --save-map
+    string mapPath = "map.bin";
+    bool serve = false; // --serve, answer "from,to" lines from stdin with json lines, on the built in map or --map=file
+    string servePath;
+    string cachePath; // --cache=file, routes served before are kept there across restarts
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--bench") bench = true;
+        else if (arg == "--check") check = true;
+        else if (arg == "--serve") serve = true;
+        else if (arg.compare(0, 6, "--map=") == 0) servePath = arg.substr(6);
+        else if (arg.compare(0, 8, "--cache=") == 0) cachePath = arg.substr(8);
+        else if (arg.compare(0, 8, "--trace=") == 0) tracePath = arg.substr(8);
+        else if (arg.compare(0, 13, "--import-osm=") == 0) osmPath = arg.substr(13);
+        else if (arg.compare(0, 11, "--save-map=") == 0) mapPath = arg.substr(11);
+    }
+    TraceSession trace(tracePath);
+
+    if (!osmPath.empty()) {
+        LinkedList osmCities;
+        Graph osmGraph;
+        OsmImporter importer;
+        auto start = chrono::steady_clock::now();
+        if (!importer.import(osmPath, osmCities, osmGraph)) {
+            cout << "could not read " << osmPath << endl;
+            return 1;
+        }
+        cout << importer.nodeCount << " nodes and " << importer.wayCount << " ways read, " << osmGraph.vertexCount()
+             << " cities and " << osmGraph.roadCount() << " roads kept in " << millisecondsSince(start) << " ms" << endl;
+        if (!saveMapBinary(mapPath, osmGraph)) {
+            cout << "could not write " << mapPath << endl;
+            return 1;
+        }
+        cout << "saved to " << mapPath << endl;
+        return 0;
+    }
 
     LinkedList ll;
 
@@ -539,7 +6352,7 @@ int main() {
     Graph graph;
 
     Node* head = ll.head;
-    while (head->next != NULL) {
+    while (head != NULL) {
         graph.addVertex(head->city, head->latitude, head->longitude);
         head = head->next;
     }
@@ -869,6 +6682,49 @@ int main() {
 
     graph.addEdge("Swat", "Malakand");
 
+    // component labels and load checks, so that unreachable routes are answered without searching
+    ConnectedComponents components(graph);
+    IntegrityReport report(ll, graph, components);
+    CityIndex cities(graph);
+    if (!report.isClean()) {
+        report.display();
+    }
+
+    if (serve) {
+#ifdef FAST_EXPLORER_ASYNC
+        GraphSnapshot* initial;
+        if (servePath.empty()) initial = GraphSnapshot::fromGraph(ll, graph, 1);
+        else if (servePath.size() >= 4 && servePath.compare(servePath.size() - 4, 4, ".csv") == 0) initial = GraphSnapshot::fromCsv(servePath, 1);
+        else initial = GraphSnapshot::fromBinary(servePath, 1);
+        if (initial == NULL) {
+            cerr << "could not load " << servePath << endl;
+            return 1;
+        }
+        SnapshotRegistry registry(initial);
+        ResultCache cache;
+        if (!cachePath.empty()) {
+            if (cache.open(cachePath, initial->fingerprint)) cerr << cache.warm() << " cached routes in " << cachePath << endl;
+            else cerr << "could not open " << cachePath << " as a result cache, serving without one" << endl;
+        }
+        RouteServer server(registry, cache.isOpen() ? &cache : NULL);
+        server.run(cin, cout);
+        cerr << server.requestCount() << " requests routed with " << server.searchCount() << " searches, "
+             << server.cacheHits.load() << " answered from the cache" << endl;
+        return 0;
+#else
+        cerr << "--serve needs a C++20 build (-std=c++20)" << endl;
+        return 1;
+#endif
+    }
+
+    // --check compares the faster searches against dijkstra or brute force, exits 1 on a difference
+    if (check) {
+        return runChecks(graph) ? 0 : 1;
+    }
+    if (bench) {
+        runBenchmarks(graph);
+        return 0;
+    }
 
     string message = "\n      ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * \n      ' ` . * ' . * , ` * ' ` . * ' . * WELCOME TO FAST EXPLORER! * ` * ' ` . * ' . * , ` * ' ` . * ' ` * \n      ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * ' ` . * ' . * , ` * \n";
     slowPrint(message, 10); 
@@ -908,11 +6764,17 @@ int main() {
         cout << "   |            1. Display cities and their geographical coordinates                       |" << endl;
         cout << "   |            2. Display cities with their neighboring cities                            |" << endl;
         cout << "   |            3. Calculate path between source and destination                           |" << endl;
-        cout << "   |            4. Exit                                                                    |" << endl;
+        cout << "   |            4. Alternative routes between source and destination                       |" << endl;
+        cout << "   |            5. Cities within a distance of a city                                      |" << endl;
+        cout << "   |            6. Plan a trip through several cities                                      |" << endl;
+        cout << "   |            7. Compare the shortest, fastest and cheapest routes                       |" << endl;
+        cout << "   |            8. Exit                                                                    |" << endl;
         cout << "   -----------------------------------------------------------------------------------------" << endl;
         int choice;
         cout << "\n\tChoice Entered : ";
-        cin >> choice;
+        if (!(cin >> choice)) {
+            return 0; // end of input
+        }
         system("cls");
 
 
@@ -993,13 +6855,19 @@ int main() {
                 string destination;
 
                 cout << "SHORTEST PATH BETWEEN CITIES" << endl << endl;
-                cout << "Enter source city name: ";
-                cin >> source;
-                Vertex* src = graph.getVertex(source);
-
-                cout << "Enter destination city name: ";
-                cin >> destination;
-                Vertex* dest = graph.getVertex(destination);
+                Vertex* src = askCity(cities, "Enter source city name: ");
+                if (src == NULL) return 0; // end of input
+                source = src->city;
+
+                Vertex* dest = askCity(cities, "Enter destination city name: ");
+                if (dest == NULL) return 0;
+                destination = dest->city;
+
+                if (!components.connected(src, dest)) {
+                    cout << endl << "No road connects " << source << " and " << destination << "." << endl;
+                    cout << endl << "=================================" << endl;
+                    break;
+                }
 
                 // using dijkstra's algo to compute the shortest path (+ distance) for each vertex in the graph w.r.t. the src vertex
                 vector<Vertex*> shortestPath = Dijkstra::getShortestPath(src, dest);
@@ -1064,6 +6932,148 @@ int main() {
             }
 
             case 4: {
+                system("cls");
+                system("Color 03");
+                cout << "ALTERNATIVE ROUTES" << endl << endl;
+                Vertex* src = askCity(cities, "Enter source city name: ");
+                if (src == NULL) return 0; // end of input
+                Vertex* dest = askCity(cities, "Enter destination city name: ");
+                if (dest == NULL) return 0;
+
+                if (!components.connected(src, dest)) {
+                    cout << endl << "No road connects " << src->city << " and " << dest->city << "." << endl;
+                    cout << endl << "=================================" << endl;
+                    break;
+                }
+
+                // the three shortest routes that do not pass a city twice
+                AlternativeRoutes alternatives(graph);
+                vector<Route> routes = alternatives.kShortestPaths(src, dest, 3);
+                for (int i = 0; i < routes.size(); i++) {
+                    cout << endl << (i == 0 ? "Shortest route: " : "Alternative " + to_string(i) + ": ") << routes[i].distance << " km";
+                    if (routes[i].toll > 0) cout << ", Rs. " << routes[i].toll << " in tolls";
+                    cout << endl;
+                    for (int j = 0; j < routes[i].path.size(); j++) {
+                        cout << (j == 0 ? "  " : " -> ") << routes[i].path[j]->city;
+                    }
+                    cout << endl;
+                }
+                if (routes.size() == 1) {
+                    cout << endl << "No other route avoids passing a city twice." << endl;
+                }
+                cout << endl << "=================================" << endl;
+                break;
+            }
+
+            case 5: {
+                system("cls");
+                system("Color 05");
+                cout << "CITIES WITHIN REACH" << endl << endl;
+                Vertex* origin = askCity(cities, "Enter city name: ");
+                if (origin == NULL) return 0; // end of input
+
+                float km;
+                cout << "Enter distance in km: ";
+                if (!(cin >> km)) {
+                    return 0; // end of input
+                }
+
+                // city | road distance from the origin, nearest first
+                Isochrone isochrone = Isochrones::withinDistance(graph, origin, km);
+                cout << endl << max(0, (int)isochrone.reachable.size() - 1) << " cities within " << km << " km of " << origin->city << ":" << endl;
+                for (int i = 1; i < isochrone.reachable.size(); i++) {
+                    cout << isochrone.reachable[i].first->city << " | " << isochrone.reachable[i].second << '\n';
+                }
+                cout << endl << "=================================" << endl;
+                break;
+            }
+
+            case 6: {
+                system("cls");
+                system("Color 03");
+                cout << "TRIP PLANNER" << endl << endl;
+                int count;
+                cout << "How many cities will you visit, the starting city included? ";
+                if (!(cin >> count)) {
+                    return 0; // end of input
+                }
+                if (count < 2) {
+                    cout << "A trip needs at least 2 cities." << endl;
+                    break;
+                }
+
+                vector<Vertex*> stops;
+                for (int i = 0; i < count; i++) {
+                    Vertex* stop = askCity(cities, i == 0 ? "Enter starting city name: " : "Enter city " + to_string(i + 1) + " name: ");
+                    if (stop == NULL) return 0;
+                    stops.push_back(stop);
+                }
+                char answer;
+                cout << "Return to " << stops[0]->city << " at the end? (y/n) ";
+                if (!(cin >> answer)) {
+                    return 0;
+                }
+
+                // the other cities are visited in whichever order is shortest
+                TripPlanner planner(graph, Metrics::distance(graph));
+                Trip trip = planner.plan(stops, answer == 'y' || answer == 'Y');
+                if (!trip.found()) {
+                    cout << endl << "No road connects all of these cities." << endl;
+                    cout << endl << "=================================" << endl;
+                    break;
+                }
+                cout << endl << "Visiting order:";
+                for (int i = 0; i < trip.stops.size(); i++) {
+                    cout << (i == 0 ? " " : " -> ") << trip.stops[i]->city;
+                }
+                cout << endl << "Total distance: " << trip.route.distance << " km" << endl << endl;
+                cout << "Cities on the way:" << endl;
+                for (int i = 0; i < trip.route.path.size(); i++) {
+                    cout << (i == 0 ? "  " : " -> ") << trip.route.path[i]->city;
+                }
+                cout << endl << endl << "=================================" << endl;
+                break;
+            }
+
+            case 7: {
+                system("cls");
+                system("Color 05");
+                cout << "SHORTEST, FASTEST AND CHEAPEST ROUTES" << endl << endl;
+                Vertex* src = askCity(cities, "Enter source city name: ");
+                if (src == NULL) return 0; // end of input
+                Vertex* dest = askCity(cities, "Enter destination city name: ");
+                if (dest == NULL) return 0;
+
+                if (!components.connected(src, dest)) {
+                    cout << endl << "No road connects " << src->city << " and " << dest->city << "." << endl;
+                    cout << endl << "=================================" << endl;
+                    break;
+                }
+
+                // every route that no other one beats on distance, tolls and time at once, shortest first
+                ParetoRoutes pareto(graph);
+                vector<Route> routes = pareto.between(src, dest);
+                for (int i = 0; i < routes.size(); i++) {
+                    cout << endl << "Route " << i + 1 << ": " << routes[i].distance << " km, " << (int)routes[i].weight / 60 << " h "
+                         << (int)routes[i].weight % 60 << " min, Rs. " << routes[i].toll << " in tolls" << endl;
+                    for (int tier = 0; tier < vehicle_tiers; tier++) {
+                        cout << (tier == 0 ? "  fares: " : ", ") << vehicle_tier_names[tier] << " Rs. " << routes[i].fares[tier];
+                        if (ParetoRoutes::cheapest(routes, tier) == i) cout << " (cheapest)";
+                    }
+                    cout << endl;
+                    for (int j = 0; j < routes[i].path.size(); j++) {
+                        cout << (j == 0 ? "  " : " -> ") << routes[i].path[j]->city;
+                    }
+                    cout << endl;
+                }
+                if (routes.size() == 1) {
+                    cout << endl << "The shortest route is also the fastest and the cheapest." << endl;
+                }
+                cout << endl << "=================================" << endl;
+                break;
+            }
+
+            case 8: {
                 system("cls");
                 cout << endl << endl << endl;
                 system("color 05");